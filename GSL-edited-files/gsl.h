@@ -0,0 +1,210 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2015 Microsoft Corporation. All rights reserved.
+//
+// This code is licensed under the MIT License (MIT).
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#ifndef GSL_GSL_H
+#define GSL_GSL_H
+
+#include "gsl_assert.h"  // Ensures/Expects
+#include "gsl_util.h"    // finally()/narrow()/narrow_cast()...
+#include "span.h"        // span, strided_span...
+#include "string_span.h" // zstring, string_span, zstring_builder...
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#ifdef _MSC_VER
+
+// No MSVC does constexpr fully yet
+#pragma push_macro("constexpr")
+#define constexpr
+
+// MSVC 2013 workarounds
+#if _MSC_VER <= 1800
+// noexcept is not understood
+#pragma push_macro("noexcept")
+#define noexcept
+
+// turn off some misguided warnings
+#pragma warning(push)
+#pragma warning(disable: 4351) // warns about newly introduced aggregate initializer behavior
+
+#endif // _MSC_VER <= 1800
+
+#endif // _MSC_VER
+
+namespace gsl
+{
+
+//
+// GSL.owner: ownership pointers
+//
+using std::unique_ptr;
+using std::shared_ptr;
+
+template <class T>
+using owner = T;
+
+//
+// trusted: tag for values already known to be non-null,
+// e.g. this, the address of a reference, the result of make_shared
+//
+struct trusted_t {};
+const trusted_t trusted{};
+
+//
+// not_null
+//
+// Restricts a pointer or smart pointer to only hold non-null values.
+//
+// Has zero size overhead over T.
+//
+// If T is a pointer (i.e. T == U*) then
+// - allow construction from U* or U&
+// - disallow construction from nullptr_t
+// - disallow default construction
+// - ensure construction from U* fails with nullptr
+// - allow implicit conversion to U*
+//
+// Edits:
+// - not_null{ t, trusted } skips the check (see not_null_from and make_not_null_shared)
+// - values are moved in and get() returns smart pointers by reference (no reference count
+//   update on access). Moving a not_null copies it, so it is never left null and get()
+//   needs no check: pass not_null<shared_ptr<T>> by const reference to avoid the count
+//
+template <class T>
+class not_null
+{
+    static_assert(std::is_assignable<T&, std::nullptr_t>::value, "T cannot be assigned nullptr.");
+
+    // small, trivially copyable values (raw pointers) by value, smart pointers by reference
+    using get_result = std::conditional_t<sizeof(T) <= sizeof(void*) && std::is_trivially_copy_constructible<T>::value, T, const T&>;
+
+public:
+    not_null(T t) : ptr_(std::move(t)) { ensure_invariant(); }
+
+    not_null(T t, trusted_t) noexcept(std::is_nothrow_move_constructible<T>::value) : ptr_(std::move(t)) {}
+
+    // e.g. not_null<shared_ptr<Base>> from shared_ptr<Derived>
+    template <typename U, typename Dummy = std::enable_if_t<std::is_convertible<U, T>::value && !std::is_same<std::decay_t<U>, T>::value>>
+    not_null(U&& u) : ptr_(std::forward<U>(u)) { ensure_invariant(); }
+
+    not_null& operator=(const T& t)
+    {
+        ptr_ = t;
+        ensure_invariant();
+        return *this;
+    }
+
+    // no move operations: std::move copies (a moved-from smart pointer would be null)
+    not_null(const not_null& other) = default;
+    not_null& operator=(const not_null& other) = default;
+
+    // other is not null already: no need to check
+    template <typename U, typename Dummy = std::enable_if_t<std::is_convertible<U, T>::value>>
+    not_null(const not_null<U>& other) : ptr_(other.get())
+    {
+    }
+
+    template <typename U, typename Dummy = std::enable_if_t<std::is_convertible<U, T>::value>>
+    not_null& operator=(const not_null<U>& other)
+    {
+        ptr_ = other.get();
+        return *this;
+    }
+
+    // prevents compilation when someone attempts to assign a nullptr
+    not_null(std::nullptr_t) = delete;
+    not_null(int) = delete;
+    not_null<T>& operator=(std::nullptr_t) = delete;
+    not_null<T>& operator=(int) = delete;
+
+    get_result get() const
+    {
+#ifdef _MSC_VER
+        __assume(ptr_ != nullptr);
+#endif
+        return ptr_;
+    } // the assume() should help the optimizer
+
+    operator T() const { return get(); }
+    get_result operator->() const { return get(); }
+
+    bool operator==(const T& rhs) const { return ptr_ == rhs; }
+    bool operator!=(const T& rhs) const { return !(*this == rhs); }
+private:
+    T ptr_;
+
+    // we assume that the compiler can hoist/prove away most of the checks inlined from this function
+    // if not, we could make them optional via conditional compilation
+    void ensure_invariant() const { Expects(ptr_ != nullptr); }
+
+    // unwanted operators...pointers only point to single objects!
+    // TODO ensure all arithmetic ops on this type are unavailable
+    not_null<T>& operator++() = delete;
+    not_null<T>& operator--() = delete;
+    not_null<T> operator++(int) = delete;
+    not_null<T> operator--(int) = delete;
+    not_null<T>& operator+(size_t) = delete;
+    not_null<T>& operator+=(size_t) = delete;
+    not_null<T>& operator-(size_t) = delete;
+    not_null<T>& operator-=(size_t) = delete;
+};
+
+// a reference cannot be null: no check
+template <class T>
+not_null<T*> not_null_from(T& ref) noexcept
+{
+    return{ std::addressof(ref), trusted };
+}
+
+// make_shared either succeeds or throws: no check
+template <class T, class... Args>
+not_null<std::shared_ptr<T>> make_not_null_shared(Args&&... args)
+{
+    return{ std::make_shared<T>(std::forward<Args>(args)...), trusted };
+}
+
+} // namespace gsl
+
+namespace std
+{
+template <class T>
+struct hash<gsl::not_null<T>>
+{
+    size_t operator()(const gsl::not_null<T>& value) const { return hash<T>{}(value.get()); }
+};
+
+} // namespace std
+
+#ifdef _MSC_VER
+
+#undef constexpr
+#pragma pop_macro("constexpr")
+
+#if _MSC_VER <= 1800
+
+#undef noexcept
+#pragma pop_macro("noexcept")
+
+#pragma warning(pop)
+
+#endif // _MSC_VER <= 1800
+
+#endif // _MSC_VER
+
+#endif // GSL_GSL_H
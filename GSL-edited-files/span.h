@@ -327,7 +327,7 @@ namespace details
         }
 
         template <typename T, size_t Dim>
-        size_type linearize(const T&) const
+        size_type linearize(const T&, bool&) const
         {
             return 0;
         }
@@ -381,12 +381,14 @@ namespace details
             this->Base::template serialize<T, Dim + 1>(arr);
         }
 
+        // m_bound is the stride of the enclosing range: the offset is a sum of products and
+        // the range checks are and-ed together (no branch per dimension, negative indices fail too)
         template <typename T, size_t Dim = 0>
-        size_type linearize(const T& arr) const
+        size_type linearize(const T& arr, bool& inRange) const
         {
             const size_type index = this->Base::totalSize() * arr[Dim];
-            Expects(index < m_bound);
-            return index + this->Base::template linearize<T, Dim + 1>(arr);
+            inRange &= static_cast<std::size_t>(index) < static_cast<std::size_t>(m_bound);
+            return index + this->Base::template linearize<T, Dim + 1>(arr, inRange);
         }
 
         template <typename T, size_t Dim = 0>
@@ -449,11 +451,11 @@ namespace details
         }
 
         template <typename T, size_t Dim = 0>
-        size_type linearize(const T& arr) const
+        size_type linearize(const T& arr, bool& inRange) const
         {
-            Expects(arr[Dim] < CurrentRange); // Index is out of range
+            inRange &= static_cast<std::size_t>(arr[Dim]) < static_cast<std::size_t>(CurrentRange);
             return this->Base::totalSize() * arr[Dim] +
-                   this->Base::template linearize<T, Dim + 1>(arr);
+                   this->Base::template linearize<T, Dim + 1>(arr, inRange);
         }
 
         template <typename T, size_t Dim = 0>
@@ -658,7 +660,14 @@ public:
 
     constexpr size_type total_size() const noexcept { return m_ranges.totalSize(); }
 
-    constexpr size_type linearize(const index_type& idx) const { return m_ranges.linearize(idx); }
+    // one check per index, not one per dimension
+    constexpr size_type linearize(const index_type& idx) const
+    {
+        bool inRange = true;
+        const size_type ret = m_ranges.linearize(idx, inRange);
+        Expects(inRange); // index is out of bounds of the array
+        return ret;
+    }
 
     constexpr bool contains(const index_type& idx) const noexcept
     {
@@ -784,10 +793,12 @@ public:
     constexpr size_type linearize(const index_type& idx) const noexcept
     {
         size_type ret = 0;
+        bool inRange = true;
         for (size_t i = 0; i < rank; i++) {
-            Expects(idx[i] < m_extents[i]); // index is out of bounds of the array
+            inRange &= static_cast<std::size_t>(idx[i]) < static_cast<std::size_t>(m_extents[i]);
             ret += idx[i] * m_strides[i];
         }
+        Expects(inRange); // index is out of bounds of the array
         return ret;
     }
 
@@ -1680,6 +1691,39 @@ constexpr auto as_span(span<byte, Dimensions...> s) noexcept -> span<
             s.size_bytes() / narrow_cast<std::ptrdiff_t>(sizeof(U))};
 }
 
+namespace details
+{
+    template <typename U>
+    bool is_aligned_for(const void* ptr) noexcept
+    {
+        return reinterpret_cast<std::uintptr_t>(ptr) % alignof(U) == 0;
+    }
+}
+
+// convert a span<const byte> to a span<const U>, checking both size and alignment
+// (as_span<U> only checks the size). Misaligned data can't be viewed as U in place:
+// read it through a copying view instead.
+template <typename U, std::ptrdiff_t... Dimensions>
+span<const U> span_cast(span<const byte, Dimensions...> s)
+{
+    static_assert(std::is_trivial<std::decay_t<U>>::value, "Target type must be a trivial type");
+    Expects(details::is_aligned_for<U>(s.data())); // data is misaligned for U
+    Expects((s.size_bytes() % sizeof(U)) == 0);
+    return {reinterpret_cast<const U*>(s.data()),
+            s.size_bytes() / narrow_cast<std::ptrdiff_t>(sizeof(U))};
+}
+
+// convert a span<byte> to a span<U>, checking both size and alignment
+template <typename U, std::ptrdiff_t... Dimensions>
+span<U> span_cast(span<byte, Dimensions...> s)
+{
+    static_assert(std::is_trivial<std::decay_t<U>>::value, "Target type must be a trivial type");
+    Expects(details::is_aligned_for<U>(s.data())); // data is misaligned for U
+    Expects((s.size_bytes() % sizeof(U)) == 0);
+    return {reinterpret_cast<U*>(s.data()),
+            s.size_bytes() / narrow_cast<std::ptrdiff_t>(sizeof(U))};
+}
+
 template <typename T, std::ptrdiff_t... Dimensions>
 constexpr auto as_span(T* const& ptr, dim<Dimensions>... args)
     -> span<std::remove_all_extents_t<T>, Dimensions...>
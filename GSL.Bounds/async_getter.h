@@ -0,0 +1,217 @@
+#pragma once
+#include "batched_getter.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Asynchronous front-end for Get_ApiC
+//
+// Requests are queued and a background worker serves everything pending in one batch
+// (through BatchedGetter, so ids are also sorted, deduplicated and chunked).
+// Callers can overlap their own work with the fetch and then:
+// - Submit(out, ids): wait on the returned PendingGet. out and ids are borrowed, hence
+//   PendingGet waits for completion also in its destructor: the spans cannot be left
+//   dangling, even if the caller forgets (or an exception skips) the Wait
+// - Submit(ids): get the values from a future, the getter owns the buffers
+// - Submit(ids, callback): receive the values on the worker thread, the getter owns the buffers
+class AsyncGetter
+{
+	struct Request
+	{
+		std::vector<unsigned> ownedIds;
+		std::vector<double> ownedValues;
+		gsl::span<const unsigned> ids;
+		gsl::span<double> out;
+		std::promise<void> done;
+	};
+
+public:
+	using Callback = std::function<void(gsl::span<const double> values, std::exception_ptr error)>;
+
+	// completion of a request on borrowed spans
+	class PendingGet
+	{
+	public:
+		PendingGet(PendingGet&&) = default;
+		PendingGet& operator=(PendingGet&&) = delete;
+		PendingGet(const PendingGet&) = delete;
+		PendingGet& operator=(const PendingGet&) = delete;
+
+		~PendingGet()
+		{
+			if (done.valid())
+				done.wait();
+		}
+
+		bool Ready() const
+		{
+			return done.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+		}
+
+		// blocks until out has been written, rethrows API errors
+		void Wait()
+		{
+			Expects(done.valid());
+			done.get();
+		}
+
+	private:
+		friend class AsyncGetter;
+		explicit PendingGet(std::future<void> done) : done(std::move(done)) {}
+
+		std::future<void> done;
+	};
+
+	explicit AsyncGetter(GetApiFunction api, std::ptrdiff_t maxBatch = 1024)
+		: getter(api, maxBatch), worker([this] { Run(); })
+	{
+	}
+
+	AsyncGetter(const AsyncGetter&) = delete;
+	AsyncGetter& operator=(const AsyncGetter&) = delete;
+
+	// pending requests are served before shutting down
+	~AsyncGetter()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		requestsAvailable.notify_one();
+		worker.join();
+	}
+
+	PendingGet Submit(gsl::span<double> out, gsl::span<const unsigned> ids)
+	{
+		Expects(ids.size() == out.size());
+		Request request;
+		request.ids = ids;
+		request.out = out;
+		auto done = request.done.get_future();
+		Enqueue(std::move(request));
+		return PendingGet{ std::move(done) };
+	}
+
+	std::future<std::vector<double>> Submit(std::vector<unsigned> ids)
+	{
+		auto result = std::make_shared<std::promise<std::vector<double>>>();
+		auto future = result->get_future();
+		Submit(std::move(ids), [result](gsl::span<const double> values, std::exception_ptr error) {
+			if (error)
+				result->set_exception(error);
+			else
+				result->set_value({ values.begin(), values.end() });
+		});
+		return future;
+	}
+
+	// callback runs on the worker thread, once: keep it short, it must not throw
+	// (it would have nowhere to go: a throwing callback terminates the program)
+	void Submit(std::vector<unsigned> ids, Callback callback)
+	{
+		Expects(callback != nullptr);
+		Request request;
+		request.ownedIds = std::move(ids);
+		request.ownedValues.resize(request.ownedIds.size());
+		request.ids = request.ownedIds;
+		request.out = request.ownedValues;
+		auto done = request.done.get_future().share();
+		auto values = request.out; // the buffer moves with its vector
+		Enqueue(std::move(request), [done, callback, values]() noexcept {
+			std::exception_ptr error;
+			try
+			{
+				done.get();
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+			if (error)
+				callback({}, error);
+			else
+				callback(values, nullptr);
+		});
+	}
+
+private:
+	void Enqueue(Request request, std::function<void()> onDone = nullptr)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queue.push_back({ std::move(request), std::move(onDone) });
+		}
+		requestsAvailable.notify_one();
+	}
+
+	void Run()
+	{
+		std::vector<Entry> batch;
+		std::vector<unsigned> ids;
+		std::vector<double> values;
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				requestsAvailable.wait(lock, [this] { return stopping || !queue.empty(); });
+				if (queue.empty())
+					return;
+				// everything submitted so far goes in the same batch
+				batch.assign(std::make_move_iterator(begin(queue)), std::make_move_iterator(end(queue)));
+				queue.clear();
+			}
+
+			ids.clear();
+			for (auto& entry : batch)
+				ids.insert(end(ids), entry.request.ids.begin(), entry.request.ids.end());
+			values.resize(ids.size());
+
+			std::exception_ptr error;
+			try
+			{
+				getter.Get(values, ids);
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+
+			std::ptrdiff_t offset = 0;
+			for (auto& entry : batch)
+			{
+				auto& request = entry.request;
+				if (error)
+				{
+					request.done.set_exception(error);
+				}
+				else
+				{
+					std::copy(begin(values) + offset, begin(values) + offset + request.out.size(), request.out.begin());
+					request.done.set_value();
+				}
+				offset += request.out.size();
+				if (entry.onDone)
+					entry.onDone();
+			}
+			batch.clear();
+		}
+	}
+
+	struct Entry
+	{
+		Request request;
+		std::function<void()> onDone;
+	};
+
+	BatchedGetter getter;
+	std::mutex mutex;
+	std::condition_variable requestsAvailable;
+	std::deque<Entry> queue;
+	bool stopping = false;
+	std::thread worker;
+};
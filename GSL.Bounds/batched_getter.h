@@ -0,0 +1,126 @@
+#pragma once
+#include "gsl.h"
+#include "span.h"
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <vector>
+
+// Get_ApiC-like functions: copy into *out* the values corresponding to *ids*
+using GetApiFunction = void(*)(double* out, const unsigned int* ids, int size);
+
+// Batching front-end for Get_ApiC
+//
+// The C API has a per-call overhead and prefers sorted, unique ids in bounded batches:
+// - Get(out, ids) sorts and deduplicates ids, calls the API in chunks of at most maxBatch ids
+//   and scatters the results back into out, in the original order
+// - Get(id) coalesces concurrent callers: while a batch is in flight, new ids wait for
+//   the next one, so many single-id requests result in a few API calls
+class BatchedGetter
+{
+public:
+	explicit BatchedGetter(GetApiFunction api, std::ptrdiff_t maxBatch = 1024)
+		: api(api), maxBatch(maxBatch), pending(std::make_shared<Batch>())
+	{
+		Expects(api != nullptr && maxBatch > 0);
+	}
+
+	void Get(gsl::span<double> out, gsl::span<const unsigned> ids) const
+	{
+		Expects(ids.size() == out.size());
+
+		// positions of ids, sorted by id
+		std::vector<std::ptrdiff_t> order(ids.size());
+		std::iota(begin(order), end(order), 0);
+		std::sort(begin(order), end(order), [&](std::ptrdiff_t l, std::ptrdiff_t r) { return ids[l] < ids[r]; });
+
+		// unique ids and, for each position, the slot of its value
+		std::vector<unsigned> uniqueIds;
+		std::vector<std::ptrdiff_t> slots(ids.size());
+		for (auto pos : order)
+		{
+			if (uniqueIds.empty() || uniqueIds.back() != ids[pos])
+				uniqueIds.push_back(ids[pos]);
+			slots[pos] = gsl::narrow_cast<std::ptrdiff_t>(uniqueIds.size()) - 1;
+		}
+
+		std::vector<double> values(uniqueIds.size());
+		Dispatch(values, uniqueIds);
+
+		for (std::ptrdiff_t i = 0; i < out.size(); ++i)
+			out[i] = values[slots[i]];
+	}
+
+	double Get(unsigned id)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		auto batch = pending;
+		const auto slot = batch->ids.size();
+		batch->ids.push_back(id);
+
+		while (!batch->done)
+		{
+			if (dispatching)
+			{
+				batchDone.wait(lock);
+				continue;
+			}
+			// nobody is calling the API: take everything that is pending (our id included)
+			dispatching = true;
+			auto current = std::move(pending);
+			pending = std::make_shared<Batch>();
+			lock.unlock();
+
+			// even if the API throws: the waiters get the error, the next caller can dispatch
+			std::exception_ptr error;
+			try
+			{
+				current->values.resize(current->ids.size());
+				Get(current->values, current->ids);
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+
+			lock.lock();
+			current->error = error;
+			current->done = true;
+			dispatching = false;
+			batchDone.notify_all();
+		}
+		if (batch->error)
+			std::rethrow_exception(batch->error);
+		return batch->values[slot];
+	}
+
+private:
+	struct Batch
+	{
+		std::vector<unsigned> ids;
+		std::vector<double> values;
+		std::exception_ptr error; // thrown to every caller of the batch
+		bool done = false;
+	};
+
+	// ids are sorted and unique here
+	void Dispatch(gsl::span<double> out, gsl::span<const unsigned> ids) const
+	{
+		for (std::ptrdiff_t offset = 0; offset < ids.size(); offset += maxBatch)
+		{
+			const auto count = std::min(maxBatch, ids.size() - offset);
+			api(out.subspan(offset, count).data(), ids.subspan(offset, count).data(), gsl::narrow<int>(count));
+		}
+	}
+
+	GetApiFunction api;
+	std::ptrdiff_t maxBatch;
+
+	std::mutex mutex;
+	std::condition_variable batchDone;
+	std::shared_ptr<Batch> pending;
+	bool dispatching = false;
+};
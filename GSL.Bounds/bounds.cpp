@@ -1,9 +1,24 @@
+#include <chrono>
+#include <cmath>
 #include <iostream>
 #include <vector>
 #include <map>
+#include <numeric>
 #include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <future>
+#include <string>
 #include "gsl.h"
 #include "span.h"
+#include "tiled_span.h"
+#include "byte_order.h"
+#include "byte_cursor.h"
+#include "batched_getter.h"
+#include "cached_getter.h"
+#include "async_getter.h"
+#include "parallel_getter.h"
 
 using namespace std;
 using namespace gsl;
@@ -141,15 +156,374 @@ struct Getter_GSL
 	// void Get(double* out, const unsigned int* ids, int size) 
 };
 
+// Batching example
+
+// stands in for Get_ApiC, logging each (slow) call
+void Logging_ApiC(double* out, const unsigned int* ids, int size)
+{
+	cout << "Get_ApiC(" << size << " ids)\n";
+	this_thread::sleep_for(chrono::milliseconds(10)); // per-call overhead
+	for (int i = 0; i < size; ++i)
+	{
+		[[gsl::suppress(bounds.1)]] // C-style API
+		{
+			out[i] = ids[i] * 1.5;
+		}
+	}
+}
+
+void call_batched_getter()
+{
+	BatchedGetter getter(Logging_ApiC, 2);
+
+	// duplicates are fetched once, 5 unique ids result in 3 calls
+	vector<unsigned> ids{ 5, 1, 3, 1, 4, 5, 2 };
+	vector<double> out(ids.size());
+	getter.Get(as_span(out), as_span(ids));
+	copy(begin(out), end(out), ostream_iterator<double>(cout, " "));
+	cout << "\n";
+
+	// single-id requests coming from many threads share the calls
+	vector<thread> callers;
+	for (unsigned id = 0; id < 8; ++id)
+		callers.emplace_back([&getter, id] { getter.Get(id); });
+	for (auto& t : callers)
+		t.join();
+}
+
+// Caching example
+
+void call_caching_getter()
+{
+	BatchedGetter batched(Logging_ApiC);
+	CachingGetter cache([&](span<double> out, span<const unsigned> ids) { batched.Get(out, ids); }, chrono::seconds(30));
+
+	// 4 threads asking for overlapping ids at the same time: only one fetch per id
+	vector<thread> callers;
+	for (unsigned t = 0; t < 4; ++t)
+	{
+		callers.emplace_back([&cache, t] {
+			vector<unsigned> ids{ 1, 2, 3, 10 + t };
+			vector<double> out(ids.size());
+			cache.Get(as_span(out), as_span(ids));
+		});
+	}
+	for (auto& t : callers)
+		t.join();
+
+	// fetch before printing: a miss logs the Get_ApiC call
+	const auto cached = cache.Get(10); // hit
+	cout << "cached: " << cached << "\n";
+	cache.Invalidate();
+	const auto refreshed = cache.Get(10); // miss
+	cout << "refreshed: " << refreshed << "\n";
+
+	const auto stats = cache.GetStats();
+	cout << "hits: " << stats.hits << " misses: " << stats.misses << " fetches: " << stats.fetches << "\n";
+}
+
 ostream& operator<<(ostream& os, const vector<double>& d)
 {
 	copy(begin(d), end(d), ostream_iterator<double>(os, " "));
 	return os;
 }
 
-int main()
+// Tiles example
+
+// s.section(origin, extents) gives a 2D window over a matrix:
+// copying it into its transpose element by element jumps across rows at every step
+void naive_transpose_copy(strided_span<const double, 2> src, strided_span<double, 2> dst)
+{
+	for (ptrdiff_t r = 0; r < src.extent<0>(); ++r)
+		for (ptrdiff_t c = 0; c < src.extent<1>(); ++c)
+			dst[{c, r}] = src[{r, c}]; // run-time checked (and cache-unfriendly)
+}
+
+void call_transpose_copy()
+{
+	vector<double> m(4 * 6);
+	iota(begin(m), end(m), 0.0);
+	auto matrix = as_span(as_span(m), dim<4>(), dim<6>());
+
+	// take a 3x4 tile and transpose it into a 4x3 matrix
+	vector<double> t(4 * 3);
+	auto transposed = as_span(as_span(t), dim<4>(), dim<3>());
+	transpose_copy(matrix.section({ 1, 2 }, { 3, 4 }), transposed.section({ 0, 0 }, { 4, 3 }), { 2, 2 });
+	cout << "Transposed:" << t << "\n";
+}
+
+// Binary frames example
+
+void call_binary_decoding()
+{
+	// frame: 2-byte big-endian id, 4-byte little-endian length, then doubles
+	alignas(double) const unsigned char raw[] = { 0x01, 0x02, 0x10, 0x00, 0x00, 0x00,
+		0, 0, 0, 0, 0, 0, 0xF0, 0x3F, 0, 0, 0, 0, 0, 0, 0x00, 0x40 };
+	auto frame = as_bytes(as_span(raw));
+
+	cout << "Frame id: " << read_be<uint16_t>(frame) << "\n";
+	cout << "Payload length: " << read_le<uint32_t>(frame) << "\n";
+
+	// the payload begins at offset 6: it cannot be viewed as double in place...
+	try
+	{
+		span_cast<double>(frame); // checked
+	}
+	catch (const fail_fast&)
+	{
+		cout << "payload is misaligned\n";
+	}
+
+	// ...but it can be read through an unaligned view
+	for (auto d : as_unaligned_span<double>(frame))
+	{
+		cout << d << " ";
+	}
+	cout << "\n";
+
+	// aligned data is viewed in place
+	alignas(double) unsigned char aligned[16]{};
+	cout << span_cast<double>(as_bytes(as_span(aligned))).size() << " doubles in place\n";
+}
+
+// IPC example
+
+struct Quote
+{
+	uint32_t id;
+	double price;
+	int64_t delta;
+	string symbol;
+};
+
+const ptrdiff_t quote_max_size = sizeof(uint32_t) + sizeof(double) + encoding::max_varint_size + encoding::max_varint_size;
+
+// the legacy way
+void serialize(ostream& os, const Quote& q)
+{
+	os.write(reinterpret_cast<const char*>(&q.id), sizeof(q.id));
+	os.write(reinterpret_cast<const char*>(&q.price), sizeof(q.price));
+	os.write(reinterpret_cast<const char*>(&q.delta), sizeof(q.delta));
+	const auto size = static_cast<uint32_t>(q.symbol.size());
+	os.write(reinterpret_cast<const char*>(&size), sizeof(size));
+	os.write(q.symbol.data(), size);
+}
+
+// one check for the whole record
+void serialize(byte_writer& writer, const Quote& q)
 {
-	call_sum_elements();
+	writer.record(quote_max_size + ptrdiff_t(q.symbol.size()))
+		.fixed(q.id)
+		.fixed(q.price)
+		.sleb128(q.delta)
+		.string(q.symbol);
+}
+
+// the same encoding, by hand: no checks at all (the caller guarantees the room)
+gsl::byte* serialize(gsl::byte* pos, const Quote& q)
+{
+	pos = encoding::put_fixed(pos, q.id);
+	pos = encoding::put_fixed(pos, q.price);
+	pos = encoding::put_sleb128(pos, q.delta);
+	return encoding::put_string(pos, q.symbol);
+}
+
+void call_binary_serialization()
+{
+	vector<double> storage(16); // any trivial storage works
+	byte_writer writer(as_writeable_bytes(as_span(storage)));
+	serialize(writer, { 42, 99.5, -3, "GSL" });
+	writer.varint(300).string("end");
+
+	byte_cursor cursor(as_bytes(writer.written()));
+	// one read per statement: the reads advance the cursor, in the order of the fields
+	auto quote = cursor.record(sizeof(uint32_t) + sizeof(double));
+	const auto id = quote.fixed<uint32_t>();
+	const auto price = quote.fixed<double>();
+	const auto delta = cursor.sleb128();
+	const auto symbol = cursor.string(); // a view on storage
+	const auto count = cursor.varint();
+	const auto trailer = cursor.string();
+	cout << "Quote: " << id << " " << price << " " << delta << " " << symbol << " | " << count << " " << trailer << "\n";
+}
+
+template<typename F>
+long long measure_ms(F f)
+{
+	const auto start = chrono::steady_clock::now();
+	f();
+	return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+}
+
+void benchmark_transpose_copy()
+{
+	const ptrdiff_t N = 4096;
+	vector<double> m(N * N), t(N * N);
+	iota(begin(m), end(m), 0.0);
+	auto src = as_span(as_span(m), dim<>(N), dim<>(N)).section({ 0, 0 }, { N, N });
+	auto dst = as_span(as_span(t), dim<>(N), dim<>(N)).section({ 0, 0 }, { N, N });
+
+	cout << "naive transpose 4Kx4K: " << measure_ms([&] { naive_transpose_copy(src, dst); }) << " ms\n";
+	cout << "tiled transpose 4Kx4K: " << measure_ms([&] { transpose_copy(src, dst); }) << " ms\n";
+}
+
+// span[{i, j, k}] checks and linearizes the index through its bounds (one check per dimension):
+// compare it with hand-written pointer arithmetic on random 3D accesses
+void benchmark_random_3d_access()
+{
+	const ptrdiff_t N = 32;
+	vector<double> data(N * N * N, 1.0);
+	auto cube = as_span(as_span(data), dim<>(N), dim<>(N), dim<>(N));
+
+	mt19937 gen(42);
+	uniform_int_distribution<ptrdiff_t> coord(0, N - 1);
+	// few enough indices to stay in cache: this measures the index computation, not the memory
+	vector<gsl::index<3>> indices(4096);
+	generate(begin(indices), end(indices), [&] { return gsl::index<3>{ coord(gen), coord(gen), coord(gen) }; });
+	const int rounds = 4000;
+
+	double spanSum = 0.0, rawSum = 0.0;
+	cout << "span random 3D access: " << measure_ms([&] {
+		for (int r = 0; r < rounds; ++r)
+			for (const auto& idx : indices)
+				spanSum += cube[idx]; // run-time checked
+	}) << " ms\n";
+
+	const double* raw = data.data();
+	cout << "raw random 3D access: " << measure_ms([&] {
+		for (int r = 0; r < rounds; ++r)
+			for (const auto& idx : indices)
+			{
+				[[gsl::suppress(bounds.1)]]
+				{
+					rawSum += raw[(idx[0] * N + idx[1]) * N + idx[2]];
+				}
+			}
+	}) << " ms\n";
+	cout << "(sums: " << spanSum << " " << rawSum << ")\n";
+}
+
+void benchmark_serialization()
+{
+	const Quote q{ 42, 99.5, -3, "GSL" };
+	const int count = 1'000'000;
+
+	// for reference: the legacy way (fixed-width fields, through a stream)
+	cout << "ostringstream serialization: " << measure_ms([&] {
+		ostringstream os;
+		for (int i = 0; i < count; ++i)
+			serialize(os, q);
+	}) << " ms\n";
+
+	// the same encoding both ways: the difference is the cost of the checks
+	vector<gsl::byte> buffer(count * (quote_max_size + q.symbol.size()));
+	cout << "unchecked serialization: " << measure_ms([&] {
+		auto pos = buffer.data();
+		for (int i = 0; i < count; ++i)
+			pos = serialize(pos, q);
+	}) << " ms\n";
+	cout << "byte_writer serialization: " << measure_ms([&] {
+		byte_writer writer(as_span(buffer));
+		for (int i = 0; i < count; ++i)
+			serialize(writer, q);
+	}) << " ms\n";
+}
+
+// Asynchronous example
+
+void call_async_getter()
+{
+	AsyncGetter getter(Logging_ApiC);
+
+	// out is borrowed: pending waits for it to be written, at the latest when it goes out of scope
+	vector<unsigned> ids{ 1, 2, 3 };
+	vector<double> out(ids.size());
+	auto pending = getter.Submit(as_span(out), as_span(ids));
+	auto values = getter.Submit({ 3, 4 }); // likely served by the same call
+	// the callback runs on the worker: it hands the value over, main prints it
+	promise<double> called;
+	auto calledValue = called.get_future();
+	getter.Submit({ 5 }, [&called](span<const double> values, exception_ptr error) {
+		if (error)
+			called.set_exception(error);
+		else
+			called.set_value(values[0]);
+	});
+
+	// ... other work overlapping with the fetch ...
+
+	// all served: the worker (and Logging_ApiC) prints nothing from now on
+	pending.Wait();
+	const auto fetched = values.get();
+	const auto callbackValue = calledValue.get();
+	cout << "async: " << out << " and " << fetched << "callback: " << callbackValue << "\n";
+}
+
+// Parallel example
+
+// stands in for a reentrant, CPU-bound Get_ApiC
+void Compute_ApiC(double* out, const unsigned int* ids, int size)
+{
+	for (int i = 0; i < size; ++i)
+	{
+		[[gsl::suppress(bounds.1)]] // C-style API
+		{
+			double value = ids[i];
+			for (int k = 0; k < 64; ++k)
+				value = sqrt(value + k);
+			out[i] = value;
+		}
+	}
+}
+
+void call_parallel_getter()
+{
+	vector<unsigned> ids(100000);
+	iota(begin(ids), end(ids), 0u);
+	vector<double> serial(ids.size()), parallel(ids.size());
+
+	ParallelGetter(Compute_ApiC, ApiReentrancy::NotReentrant).Get(as_span(serial), as_span(ids));
+	ParallelGetter(Compute_ApiC, ApiReentrancy::Reentrant, 4).Get(as_span(parallel), as_span(ids));
+	cout << "parallel matches serial: " << boolalpha << (serial == parallel) << "\n";
+}
+
+void benchmark_parallel_getter()
+{
+	vector<unsigned> ids(4 * 1024 * 1024);
+	iota(begin(ids), end(ids), 0u);
+	vector<double> out(ids.size());
+
+	const auto serial = measure_ms([&] { ParallelGetter(Compute_ApiC, ApiReentrancy::NotReentrant).Get(as_span(out), as_span(ids)); });
+	cout << "Get_ApiC serial: " << serial << " ms\n";
+	for (size_t threads = 2; threads <= max(thread::hardware_concurrency(), 2u); threads *= 2)
+	{
+		ParallelGetter getter(Compute_ApiC, ApiReentrancy::Reentrant, threads);
+		const auto elapsed = measure_ms([&] { getter.Get(as_span(out), as_span(ids)); });
+		cout << "Get_ApiC on " << threads << " threads: " << elapsed << " ms (x" << double(serial) / max(elapsed, 1LL) << ")\n";
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	call_transpose_copy();
+	call_binary_decoding();
+	call_binary_serialization();
+	call_batched_getter();
+	call_caching_getter();
+	call_async_getter();
+	call_parallel_getter();
+
+	// run with "bench" to measure (it takes a while)
+	if (argc > 1 && argv[1] == "bench"s)
+	{
+		benchmark_transpose_copy();
+		benchmark_random_3d_access();
+		benchmark_serialization();
+		benchmark_parallel_getter();
+		return 0;
+	}
+
+	call_sum_elements(); // fails on purpose: keep it after the other examples
 
 	Getter getter;
 	cout << "Got:" << getter.Get(1) << "\n";
@@ -0,0 +1,292 @@
+#pragma once
+#include "byte_order.h"
+#include "string_view.h"
+#include <cassert>
+#include <cstdint>
+
+// Streaming binary encoding over span<byte> (e.g. from as_writeable_bytes/as_bytes)
+//
+// byte_writer and byte_cursor advance through a span of bytes and check bounds
+// at each field. A record, instead, checks once that its size fits the buffer: its
+// fixed-width fields are then read and written without checks (the size of the record
+// is up to the caller: a mis-sized record is a bug, caught by an assert in debug builds).
+// Variable-length fields are still checked against the end of the record, since their
+// size depends on the data (untrusted, when reading).
+//
+// Encoding: fixed-width values (integers and floating points) are little-endian,
+// varint is unsigned LEB128, sleb128 is signed LEB128,
+// strings are a varint length followed by their characters.
+
+namespace encoding
+{
+	const std::ptrdiff_t max_varint_size = 10; // 64 bits, 7 bits per byte
+
+	inline std::ptrdiff_t varint_size(std::uint64_t value) noexcept
+	{
+		std::ptrdiff_t size = 1;
+		while (value >= 0x80)
+		{
+			value >>= 7;
+			++size;
+		}
+		return size;
+	}
+
+	inline std::ptrdiff_t sleb128_size(std::int64_t value) noexcept
+	{
+		std::ptrdiff_t size = 1;
+		while (value < -64 || value > 63)
+		{
+			value >>= 7;
+			++size;
+		}
+		return size;
+	}
+
+	inline std::ptrdiff_t string_size(experimental::string_view str) noexcept
+	{
+		return varint_size(str.size()) + static_cast<std::ptrdiff_t>(str.size());
+	}
+
+	// unchecked primitives: the caller guarantees the room
+
+	template<typename T>
+	gsl::byte* put_fixed(gsl::byte* pos, T value) noexcept
+	{
+		static_assert(std::is_arithmetic<T>::value, "put_fixed requires an arithmetic type");
+		bytes::store(pos, bytes::is_little_endian() ? value : bytes::byte_swap_value(value));
+		return pos + sizeof(T);
+	}
+
+	inline gsl::byte* put_varint(gsl::byte* pos, std::uint64_t value) noexcept
+	{
+		while (value >= 0x80)
+		{
+			*pos++ = static_cast<gsl::byte>((value & 0x7F) | 0x80);
+			value >>= 7;
+		}
+		*pos++ = static_cast<gsl::byte>(value);
+		return pos;
+	}
+
+	inline gsl::byte* put_sleb128(gsl::byte* pos, std::int64_t value) noexcept
+	{
+		while (value < -64 || value > 63)
+		{
+			*pos++ = static_cast<gsl::byte>((value & 0x7F) | 0x80);
+			value >>= 7;
+		}
+		*pos++ = static_cast<gsl::byte>(value & 0x7F);
+		return pos;
+	}
+
+	inline gsl::byte* put_string(gsl::byte* pos, experimental::string_view str) noexcept
+	{
+		pos = put_varint(pos, str.size());
+		std::memcpy(pos, str.data(), str.size());
+		return pos + str.size();
+	}
+}
+
+class byte_writer
+{
+public:
+	// writes fields in a window already checked by byte_writer::record
+	class record_writer
+	{
+	public:
+		template<typename T>
+		record_writer& fixed(T value)
+		{
+			assert(limit_ - pos_ >= static_cast<std::ptrdiff_t>(sizeof(T))); // the record is too small
+			pos_ = encoding::put_fixed(pos_, value);
+			return *this;
+		}
+
+		record_writer& varint(std::uint64_t value)
+		{
+			require(encoding::varint_size(value));
+			pos_ = encoding::put_varint(pos_, value);
+			return *this;
+		}
+
+		record_writer& sleb128(std::int64_t value)
+		{
+			require(encoding::sleb128_size(value));
+			pos_ = encoding::put_sleb128(pos_, value);
+			return *this;
+		}
+
+		record_writer& string(experimental::string_view str)
+		{
+			require(encoding::string_size(str));
+			pos_ = encoding::put_string(pos_, str);
+			return *this;
+		}
+
+	private:
+		friend class byte_writer;
+		record_writer(gsl::byte*& pos, gsl::byte* limit) : pos_(pos), limit_(limit) {}
+
+		// variable-length fields: their size depends on the values
+		void require(std::ptrdiff_t size) const
+		{
+			Expects(limit_ - pos_ >= size);
+		}
+
+		gsl::byte*& pos_;
+		gsl::byte* limit_;
+	};
+
+	explicit byte_writer(gsl::span<gsl::byte> buffer) noexcept
+		: buffer_(buffer), pos_(buffer.data())
+	{
+	}
+
+	// checks once that *maxSize* bytes are available for the fields of a record
+	record_writer record(std::ptrdiff_t maxSize)
+	{
+		Expects(maxSize >= 0 && maxSize <= remaining());
+		return{ pos_, pos_ + maxSize };
+	}
+
+	// single fields, each one checked
+
+	template<typename T>
+	byte_writer& fixed(T value)
+	{
+		record(sizeof(T)).fixed(value);
+		return *this;
+	}
+
+	byte_writer& varint(std::uint64_t value)
+	{
+		record(encoding::varint_size(value)).varint(value);
+		return *this;
+	}
+
+	byte_writer& sleb128(std::int64_t value)
+	{
+		record(encoding::sleb128_size(value)).sleb128(value);
+		return *this;
+	}
+
+	byte_writer& string(experimental::string_view str)
+	{
+		record(encoding::string_size(str)).string(str);
+		return *this;
+	}
+
+	std::ptrdiff_t size() const noexcept { return pos_ - buffer_.data(); }
+
+	std::ptrdiff_t remaining() const noexcept { return buffer_.size() - size(); }
+
+	// what has been encoded so far
+	gsl::span<gsl::byte> written() const noexcept { return buffer_.subspan(0, size()); }
+
+private:
+	gsl::span<gsl::byte> buffer_;
+	gsl::byte* pos_;
+};
+
+class byte_cursor
+{
+public:
+	// reads fields in a window already checked by byte_cursor::record
+	// Note: variable-length fields are still checked against the end of the record
+	// since their size depends on the (untrusted) data
+	class record_reader
+	{
+	public:
+		template<typename T>
+		T fixed()
+		{
+			static_assert(std::is_arithmetic<T>::value, "fixed requires an arithmetic type");
+			assert(limit_ - pos_ >= static_cast<std::ptrdiff_t>(sizeof(T))); // the record is too small
+			auto value = bytes::load<T>(pos_);
+			pos_ += sizeof(T);
+			return bytes::is_little_endian() ? value : bytes::byte_swap_value(value);
+		}
+
+		std::uint64_t varint()
+		{
+			std::uint64_t value = 0;
+			for (int shift = 0;; shift += 7)
+			{
+				Expects(pos_ < limit_ && shift < 64); // truncated or overlong varint
+				const auto b = static_cast<std::uint8_t>(*pos_++);
+				value |= static_cast<std::uint64_t>(b & 0x7F) << shift;
+				if ((b & 0x80) == 0)
+					return value;
+			}
+		}
+
+		std::int64_t sleb128()
+		{
+			std::uint64_t value = 0;
+			int shift = 0;
+			std::uint8_t b = 0;
+			do
+			{
+				Expects(pos_ < limit_ && shift < 64); // truncated or overlong sleb128
+				b = static_cast<std::uint8_t>(*pos_++);
+				value |= static_cast<std::uint64_t>(b & 0x7F) << shift;
+				shift += 7;
+			} while (b & 0x80);
+
+			if (shift < 64 && (b & 0x40)) // sign extension
+				value |= ~std::uint64_t{} << shift;
+			return static_cast<std::int64_t>(value);
+		}
+
+		// the view refers to the underlying buffer: no copies
+		experimental::string_view string()
+		{
+			const auto size = varint();
+			Expects(size <= static_cast<std::uint64_t>(limit_ - pos_));
+			experimental::string_view str{ reinterpret_cast<const char*>(pos_), static_cast<size_t>(size) };
+			pos_ += size;
+			return str;
+		}
+
+	private:
+		friend class byte_cursor;
+		record_reader(const gsl::byte*& pos, const gsl::byte* limit) : pos_(pos), limit_(limit) {}
+
+		const gsl::byte*& pos_;
+		const gsl::byte* limit_;
+	};
+
+	explicit byte_cursor(gsl::span<const gsl::byte> data) noexcept
+		: data_(data), pos_(data.data())
+	{
+	}
+
+	// checks once that the next record has *size* bytes
+	record_reader record(std::ptrdiff_t size)
+	{
+		Expects(size >= 0 && size <= remaining());
+		return{ pos_, pos_ + size };
+	}
+
+	// single fields, each one checked
+
+	template<typename T>
+	T fixed() { return record(sizeof(T)).template fixed<T>(); }
+
+	std::uint64_t varint() { return record(remaining()).varint(); }
+
+	std::int64_t sleb128() { return record(remaining()).sleb128(); }
+
+	experimental::string_view string() { return record(remaining()).string(); }
+
+	std::ptrdiff_t position() const noexcept { return pos_ - data_.data(); }
+
+	std::ptrdiff_t remaining() const noexcept { return data_.size() - position(); }
+
+	bool empty() const noexcept { return remaining() == 0; }
+
+private:
+	gsl::span<const gsl::byte> data_;
+	const gsl::byte* pos_;
+};
@@ -0,0 +1,175 @@
+#pragma once
+#include "span.h"
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+
+// Zero-copy decoding of binary buffers
+//
+// span_cast<T> (see span.h) views bytes as T in place, but only if they are
+// suitably aligned. Network frames often are not: unaligned_span<T> views them
+// as a sequence of T anyway, loading each element with memcpy.
+// read_le/read_be decode a value from the front of a byte span and advance it,
+// write_le/write_be do the opposite.
+
+namespace bytes
+{
+	inline bool is_little_endian() noexcept
+	{
+		const std::uint16_t one = 1;
+		unsigned char first;
+		std::memcpy(&first, &one, 1);
+		return first == 1;
+	}
+
+	inline std::uint8_t byte_swap(std::uint8_t v) noexcept { return v; }
+
+	inline std::uint16_t byte_swap(std::uint16_t v) noexcept
+	{
+		return static_cast<std::uint16_t>((v << 8) | (v >> 8));
+	}
+
+	inline std::uint32_t byte_swap(std::uint32_t v) noexcept
+	{
+		return ((v & 0x000000FFu) << 24) | ((v & 0x0000FF00u) << 8) |
+			((v & 0x00FF0000u) >> 8) | ((v & 0xFF000000u) >> 24);
+	}
+
+	inline std::uint64_t byte_swap(std::uint64_t v) noexcept
+	{
+		return (static_cast<std::uint64_t>(byte_swap(static_cast<std::uint32_t>(v))) << 32) |
+			byte_swap(static_cast<std::uint32_t>(v >> 32));
+	}
+
+	template<size_t Size> struct unsigned_of_size;
+	template<> struct unsigned_of_size<1> { using type = std::uint8_t; };
+	template<> struct unsigned_of_size<2> { using type = std::uint16_t; };
+	template<> struct unsigned_of_size<4> { using type = std::uint32_t; };
+	template<> struct unsigned_of_size<8> { using type = std::uint64_t; };
+
+	// works for every arithmetic type (floating points included)
+	template<typename T>
+	T byte_swap_value(T value) noexcept
+	{
+		using U = typename unsigned_of_size<sizeof(T)>::type;
+		U bits;
+		std::memcpy(&bits, &value, sizeof(T));
+		bits = byte_swap(bits);
+		std::memcpy(&value, &bits, sizeof(T));
+		return value;
+	}
+
+	// loads a T from *ptr*, whatever its alignment
+	// memcpy: gsl::byte does not alias T, and compilers emit a single mov anyway
+	template<typename T>
+	T load(const gsl::byte* ptr) noexcept
+	{
+		T value;
+		std::memcpy(&value, ptr, sizeof(T));
+		return value;
+	}
+
+	// stores *value* at *ptr*, whatever its alignment
+	template<typename T>
+	void store(gsl::byte* ptr, T value) noexcept
+	{
+		std::memcpy(ptr, &value, sizeof(T));
+	}
+}
+
+// read-only view of bytes as a sequence of T, regardless of their alignment
+template<typename T>
+class unaligned_span
+{
+	static_assert(std::is_trivial<T>::value, "unaligned_span requires a trivial type");
+	static const std::ptrdiff_t elem_size = sizeof(T);
+public:
+	using value_type = T;
+	using size_type = std::ptrdiff_t;
+
+	class iterator : public std::iterator<std::input_iterator_tag, T, std::ptrdiff_t, const T*, T>
+	{
+	public:
+		iterator(const gsl::byte* ptr) : ptr_(ptr) {}
+		T operator*() const { T value; std::memcpy(&value, ptr_, sizeof(T)); return value; }
+		iterator& operator++() { ptr_ += elem_size; return *this; }
+		iterator operator++(int) { auto ret = *this; ++(*this); return ret; }
+		bool operator==(const iterator& other) const { return ptr_ == other.ptr_; }
+		bool operator!=(const iterator& other) const { return ptr_ != other.ptr_; }
+	private:
+		const gsl::byte* ptr_;
+	};
+
+	explicit unaligned_span(gsl::span<const gsl::byte> bytes)
+		: bytes_(bytes)
+	{
+		Expects(bytes.size() % elem_size == 0);
+	}
+
+	size_type size() const noexcept { return bytes_.size() / elem_size; }
+
+	bool empty() const noexcept { return bytes_.empty(); }
+
+	T operator[](size_type idx) const
+	{
+		Expects(idx >= 0 && idx < size());
+		T value;
+		std::memcpy(&value, bytes_.data() + idx * elem_size, sizeof(T));
+		return value;
+	}
+
+	iterator begin() const { return{ bytes_.data() }; }
+	iterator end() const { return{ bytes_.data() + bytes_.size() }; }
+
+private:
+	gsl::span<const gsl::byte> bytes_;
+};
+
+template<typename T>
+unaligned_span<T> as_unaligned_span(gsl::span<const gsl::byte> bytes)
+{
+	return unaligned_span<T>{ bytes };
+}
+
+// decode a little-endian T from the front of *cursor*, then move past it
+template<typename T>
+T read_le(gsl::span<const gsl::byte>& cursor)
+{
+	static_assert(std::is_arithmetic<T>::value, "read_le requires an arithmetic type");
+	Expects(cursor.size() >= static_cast<std::ptrdiff_t>(sizeof(T)));
+	auto value = bytes::load<T>(cursor.data());
+	cursor = cursor.subspan(sizeof(T));
+	return bytes::is_little_endian() ? value : bytes::byte_swap_value(value);
+}
+
+// decode a big-endian (network order) T from the front of *cursor*, then move past it
+template<typename T>
+T read_be(gsl::span<const gsl::byte>& cursor)
+{
+	static_assert(std::is_arithmetic<T>::value, "read_be requires an arithmetic type");
+	Expects(cursor.size() >= static_cast<std::ptrdiff_t>(sizeof(T)));
+	auto value = bytes::load<T>(cursor.data());
+	cursor = cursor.subspan(sizeof(T));
+	return bytes::is_little_endian() ? bytes::byte_swap_value(value) : value;
+}
+
+// encode *value* as little-endian at the front of *cursor*, then move past it
+template<typename T>
+void write_le(gsl::span<gsl::byte>& cursor, T value)
+{
+	static_assert(std::is_arithmetic<T>::value, "write_le requires an arithmetic type");
+	Expects(cursor.size() >= static_cast<std::ptrdiff_t>(sizeof(T)));
+	bytes::store(cursor.data(), bytes::is_little_endian() ? value : bytes::byte_swap_value(value));
+	cursor = cursor.subspan(sizeof(T));
+}
+
+// encode *value* as big-endian (network order) at the front of *cursor*, then move past it
+template<typename T>
+void write_be(gsl::span<gsl::byte>& cursor, T value)
+{
+	static_assert(std::is_arithmetic<T>::value, "write_be requires an arithmetic type");
+	Expects(cursor.size() >= static_cast<std::ptrdiff_t>(sizeof(T)));
+	bytes::store(cursor.data(), bytes::is_little_endian() ? bytes::byte_swap_value(value) : value);
+	cursor = cursor.subspan(sizeof(T));
+}
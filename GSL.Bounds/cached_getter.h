@@ -0,0 +1,173 @@
+#pragma once
+#include "gsl.h"
+#include "span.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+// Getter-like batch functions (e.g. wrapping Getter_GSL::Get or BatchedGetter::Get)
+using BatchGetFunction = std::function<void(gsl::span<double> out, gsl::span<const unsigned> ids)>;
+
+// Read-mostly cache in front of a batch getter
+//
+// - values are split into shards, each one guarded by a reader/writer lock
+// - a value is fresh until its time-to-live elapses or Invalidate() starts a new epoch
+// - single-flight: ids missed by several threads at once are fetched only by the first one,
+//   the others wait for its result. Each caller fetches all its own misses in one batch call
+class CachingGetter
+{
+public:
+	using clock = std::chrono::steady_clock;
+
+	struct Stats
+	{
+		std::uint64_t hits;
+		std::uint64_t misses;
+		std::uint64_t fetches; // batch calls to the underlying getter
+	};
+
+	CachingGetter(BatchGetFunction fetch, clock::duration ttl = clock::duration::max(), std::size_t shardCount = 16)
+		: fetch(std::move(fetch)), ttl(ttl), shardCount(shardCount), shards(new Shard[shardCount])
+	{
+		Expects(this->fetch && shardCount > 0);
+	}
+
+	double Get(unsigned id)
+	{
+		double value = 0.0;
+		Get({ &value, 1 }, { &id, 1 });
+		return value;
+	}
+
+	void Get(gsl::span<double> out, gsl::span<const unsigned> ids)
+	{
+		Expects(ids.size() == out.size());
+		const auto now = clock::now();
+		const auto epoch = currentEpoch.load(std::memory_order_acquire);
+
+		std::vector<std::ptrdiff_t> missed;
+		for (std::ptrdiff_t i = 0; i < ids.size(); ++i)
+		{
+			if (!Lookup(ids[i], now, epoch, out[i]))
+				missed.push_back(i);
+		}
+		hits += static_cast<std::uint64_t>(ids.size()) - missed.size();
+		misses += missed.size();
+		if (missed.empty())
+			return;
+
+		// split misses into the ones we fetch and the ones somebody else is already fetching
+		std::vector<unsigned> toFetch;
+		std::vector<std::shared_ptr<std::promise<double>>> promises;
+		std::vector<std::pair<std::ptrdiff_t, std::shared_future<double>>> waiting;
+		for (auto i : missed)
+		{
+			auto& shard = ShardOf(ids[i]);
+			std::unique_lock<std::shared_timed_mutex> lock(shard.mutex);
+			auto inFlight = shard.inFlight.find(ids[i]);
+			if (inFlight != end(shard.inFlight))
+			{
+				waiting.emplace_back(i, inFlight->second);
+				continue;
+			}
+			auto promise = std::make_shared<std::promise<double>>();
+			auto future = promise->get_future().share();
+			shard.inFlight.emplace(ids[i], future);
+			waiting.emplace_back(i, future);
+			toFetch.push_back(ids[i]);
+			promises.push_back(std::move(promise));
+		}
+
+		if (!toFetch.empty())
+			Fetch(toFetch, promises, now, epoch);
+
+		for (auto& w : waiting)
+			out[w.first] = w.second.get();
+	}
+
+	// every cached value becomes stale
+	void Invalidate() noexcept
+	{
+		currentEpoch.fetch_add(1, std::memory_order_acq_rel);
+	}
+
+	Stats GetStats() const noexcept
+	{
+		return{ hits.load(), misses.load(), fetches.load() };
+	}
+
+private:
+	struct Entry
+	{
+		double value;
+		std::uint64_t epoch;
+		clock::time_point expiry;
+	};
+
+	struct Shard
+	{
+		std::shared_timed_mutex mutex;
+		std::unordered_map<unsigned, Entry> entries;
+		std::unordered_map<unsigned, std::shared_future<double>> inFlight;
+	};
+
+	Shard& ShardOf(unsigned id) const noexcept { return shards[id % shardCount]; }
+
+	bool Lookup(unsigned id, clock::time_point now, std::uint64_t epoch, double& value) const
+	{
+		auto& shard = ShardOf(id);
+		std::shared_lock<std::shared_timed_mutex> lock(shard.mutex);
+		auto it = shard.entries.find(id);
+		if (it == end(shard.entries) || it->second.epoch != epoch || it->second.expiry <= now)
+			return false;
+		value = it->second.value;
+		return true;
+	}
+
+	void Fetch(const std::vector<unsigned>& ids, std::vector<std::shared_ptr<std::promise<double>>>& promises, clock::time_point now, std::uint64_t epoch)
+	{
+		std::vector<double> values(ids.size());
+		std::exception_ptr error;
+		try
+		{
+			++fetches;
+			fetch(values, ids);
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+
+		const auto expiry = ttl == clock::duration::max() ? clock::time_point::max() : now + ttl;
+		for (size_t i = 0; i < ids.size(); ++i)
+		{
+			auto& shard = ShardOf(ids[i]);
+			{
+				std::unique_lock<std::shared_timed_mutex> lock(shard.mutex);
+				if (!error)
+					shard.entries[ids[i]] = { values[i], epoch, expiry };
+				shard.inFlight.erase(ids[i]);
+			}
+			if (error)
+				promises[i]->set_exception(error);
+			else
+				promises[i]->set_value(values[i]);
+		}
+	}
+
+	BatchGetFunction fetch;
+	clock::duration ttl;
+	std::size_t shardCount;
+	std::unique_ptr<Shard[]> shards;
+
+	std::atomic<std::uint64_t> currentEpoch{ 0 };
+	std::atomic<std::uint64_t> hits{ 0 };
+	std::atomic<std::uint64_t> misses{ 0 };
+	std::atomic<std::uint64_t> fetches{ 0 };
+};
@@ -0,0 +1,154 @@
+#pragma once
+#include "batched_getter.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running queued tasks
+class ThreadPool
+{
+public:
+	explicit ThreadPool(std::size_t threadCount)
+	{
+		Expects(threadCount > 0);
+		workers.reserve(threadCount);
+		for (std::size_t i = 0; i < threadCount; ++i)
+			workers.emplace_back([this] { Run(); });
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		tasksAvailable.notify_all();
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	std::size_t Size() const noexcept { return workers.size(); }
+
+	std::future<void> Submit(std::function<void()> task)
+	{
+		std::packaged_task<void()> packaged(std::move(task));
+		auto done = packaged.get_future();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tasks.push_back(std::move(packaged));
+		}
+		tasksAvailable.notify_one();
+		return done;
+	}
+
+private:
+	void Run()
+	{
+		for (;;)
+		{
+			std::packaged_task<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				tasksAvailable.wait(lock, [this] { return stopping || !tasks.empty(); });
+				if (tasks.empty())
+					return;
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+			task();
+		}
+	}
+
+	std::mutex mutex;
+	std::condition_variable tasksAvailable;
+	std::deque<std::packaged_task<void()>> tasks;
+	bool stopping = false;
+	std::vector<std::thread> workers;
+};
+
+// whether Get_ApiC can be called by several threads at the same time
+enum class ApiReentrancy { NotReentrant, Reentrant };
+
+// Parallel front-end for Get_ApiC, for huge id sets
+//
+// out and ids are split into matching subspans, at most one per degree of parallelism
+// and none smaller than minPartition. Each one results in its own Get_ApiC call,
+// run on the pool (the calling thread takes the first partition).
+// A non-reentrant API is always called serially, with a single call.
+class ParallelGetter
+{
+public:
+	ParallelGetter(GetApiFunction api, ApiReentrancy reentrancy, std::size_t parallelism = std::thread::hardware_concurrency(), std::ptrdiff_t minPartition = 4096)
+		: api(api), parallelism(std::max<std::size_t>(parallelism, 1)), minPartition(minPartition)
+	{
+		Expects(api != nullptr && minPartition > 0);
+		if (reentrancy == ApiReentrancy::Reentrant && this->parallelism > 1)
+			pool = std::make_unique<ThreadPool>(this->parallelism - 1);
+	}
+
+	void Get(gsl::span<double> out, gsl::span<const unsigned> ids) const
+	{
+		Expects(ids.size() == out.size());
+		const auto size = ids.size();
+		const auto maxPartitions = gsl::narrow_cast<std::ptrdiff_t>(parallelism);
+		const auto partitions = pool ? std::min(maxPartitions, (size + minPartition - 1) / minPartition) : 1;
+		if (partitions <= 1)
+		{
+			Call(out, ids);
+			return;
+		}
+
+		// the first (size % partitions) partitions get one more element
+		const auto partitionSize = size / partitions;
+		const auto remainder = size % partitions;
+		auto offsetOf = [=](std::ptrdiff_t p) { return p * partitionSize + std::min(p, remainder); };
+
+		std::vector<std::future<void>> done;
+		done.reserve(partitions - 1);
+		for (std::ptrdiff_t p = 1; p < partitions; ++p)
+		{
+			const auto offset = offsetOf(p);
+			const auto count = offsetOf(p + 1) - offset;
+			auto partOut = out.subspan(offset, count);
+			auto partIds = ids.subspan(offset, count);
+			done.push_back(pool->Submit([=] { Call(partOut, partIds); }));
+		}
+		std::exception_ptr error;
+		try
+		{
+			Call(out.subspan(0, offsetOf(1)), ids.subspan(0, offsetOf(1)));
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+
+		// wait for every partition before rethrowing: they all write into out
+		for (auto& d : done)
+			d.wait();
+		if (error)
+			std::rethrow_exception(error);
+		for (auto& d : done)
+			d.get();
+	}
+
+private:
+	void Call(gsl::span<double> out, gsl::span<const unsigned> ids) const
+	{
+		api(out.data(), ids.data(), gsl::narrow<int>(ids.size()));
+	}
+
+	GetApiFunction api;
+	std::size_t parallelism;
+	std::ptrdiff_t minPartition;
+	std::unique_ptr<ThreadPool> pool;
+};
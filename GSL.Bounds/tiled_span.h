@@ -0,0 +1,128 @@
+#pragma once
+#include "span.h"
+#include <algorithm>
+#include <cstddef>
+
+// Cache-blocked traversal of strided_span
+//
+// Walking a big 2D section row by row is fine as long as we only read it.
+// As soon as we also touch another matrix column by column (e.g. transposing)
+// every step lands on a different cache line and the cache is thrashed.
+// Visiting the span tile by tile keeps the working set small enough to stay in cache.
+
+namespace tiling
+{
+	// typical x86 data cache sizes, tune them for the target machine
+	const std::ptrdiff_t L1_bytes = 32 * 1024;
+	const std::ptrdiff_t L2_bytes = 256 * 1024;
+
+	// largest power-of-two side such that *count* square tiles of *rank* dimensions
+	// of *elemSize*-byte elements fit into *cacheBytes*
+	constexpr std::ptrdiff_t tile_side(std::ptrdiff_t elemSize, std::ptrdiff_t cacheBytes, std::ptrdiff_t count, std::size_t rank, std::ptrdiff_t side = 1)
+	{
+		return (count * elemSize * (rank == 2 ? (2 * side) * (2 * side) : (2 * side) * (2 * side) * (2 * side)) > cacheBytes)
+			? side
+			: tile_side(elemSize, cacheBytes, count, rank, 2 * side);
+	}
+
+	// tile extents such that a source and a destination tile both stay in L1
+	template<typename T, std::size_t Rank>
+	gsl::index<Rank> l1_tile()
+	{
+		gsl::index<Rank> tile;
+		for (std::size_t i = 0; i < Rank; ++i)
+			tile[i] = tile_side(sizeof(T), L1_bytes, 2, Rank);
+		return tile;
+	}
+
+	// same as above, for algorithms that can afford L2 latency
+	template<typename T, std::size_t Rank>
+	gsl::index<Rank> l2_tile()
+	{
+		gsl::index<Rank> tile;
+		for (std::size_t i = 0; i < Rank; ++i)
+			tile[i] = tile_side(sizeof(T), L2_bytes, 2, Rank);
+		return tile;
+	}
+}
+
+// calls f(origin, tile) for each tile of *s*, where *tile* is s.section(origin, extents)
+// and extents are clamped at the borders of *s*
+template<typename T, typename F>
+void for_each_tile(gsl::strided_span<T, 2> s, gsl::index<2> tile, F f)
+{
+	Expects(tile[0] > 0 && tile[1] > 0);
+	const auto rows = s.template extent<0>();
+	const auto cols = s.template extent<1>();
+	for (std::ptrdiff_t r = 0; r < rows; r += tile[0])
+	{
+		for (std::ptrdiff_t c = 0; c < cols; c += tile[1])
+		{
+			const gsl::index<2> origin{ r, c };
+			f(origin, s.section(origin, { std::min(tile[0], rows - r), std::min(tile[1], cols - c) }));
+		}
+	}
+}
+
+template<typename T, typename F>
+void for_each_tile(gsl::strided_span<T, 3> s, gsl::index<3> tile, F f)
+{
+	Expects(tile[0] > 0 && tile[1] > 0 && tile[2] > 0);
+	const auto planes = s.template extent<0>();
+	const auto rows = s.template extent<1>();
+	const auto cols = s.template extent<2>();
+	for (std::ptrdiff_t p = 0; p < planes; p += tile[0])
+	{
+		for (std::ptrdiff_t r = 0; r < rows; r += tile[1])
+		{
+			for (std::ptrdiff_t c = 0; c < cols; c += tile[2])
+			{
+				const gsl::index<3> origin{ p, r, c };
+				f(origin, s.section(origin, { std::min(tile[0], planes - p), std::min(tile[1], rows - r), std::min(tile[2], cols - c) }));
+			}
+		}
+	}
+}
+
+// default tiling: both the tile and its counterpart fit into L1
+template<typename T, std::size_t Rank, typename F>
+void for_each_tile(gsl::strided_span<T, Rank> s, F f)
+{
+	for_each_tile(s, tiling::l1_tile<T, Rank>(), f);
+}
+
+// dst = transpose(src), visited tile by tile
+// Note: bounds are checked once per tile (by section), not per element
+template<typename T, typename U>
+void transpose_copy(gsl::strided_span<T, 2> src, gsl::strided_span<U, 2> dst, gsl::index<2> tile)
+{
+	Expects(src.template extent<0>() == dst.template extent<1>() && src.template extent<1>() == dst.template extent<0>());
+
+	for_each_tile(src, tile, [&](const gsl::index<2>& origin, gsl::strided_span<T, 2> in)
+	{
+		const auto rows = in.template extent<0>();
+		const auto cols = in.template extent<1>();
+		auto out = dst.section({ origin[1], origin[0] }, { cols, rows });
+
+		const auto inStrides = in.bounds().strides();
+		const auto outStrides = out.bounds().strides();
+		const auto inData = in.data();
+		const auto outData = out.data();
+		for (std::ptrdiff_t r = 0; r < rows; ++r)
+		{
+			for (std::ptrdiff_t c = 0; c < cols; ++c)
+			{
+				[[gsl::suppress(bounds.1)]] // the tile has been already checked
+				{
+					outData[c * outStrides[0] + r * outStrides[1]] = inData[r * inStrides[0] + c * inStrides[1]];
+				}
+			}
+		}
+	});
+}
+
+template<typename T, typename U>
+void transpose_copy(gsl::strided_span<T, 2> src, gsl::strided_span<U, 2> dst)
+{
+	transpose_copy(src, dst, tiling::l1_tile<std::remove_const_t<T>, 2>());
+}
@@ -0,0 +1,224 @@
+#pragma once
+#include "gsl.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Bounded pool of connections (e.g. Service* from GetService) kept alive in the background
+//
+// A background thread connects the free slots, retrying failed attempts with exponential
+// backoff, and health-checks idle connections. Checkout is lock-free: it claims an idle
+// slot with a compare-and-swap and returns a Lease, which gives back the connection when
+// destroyed. A caller that finds a connection broken calls MarkBroken: the slot is
+// reconnected in the background, never on the request path.
+// Connections are not owned: connect only hands out pointers.
+template<typename T>
+class ConnectionPool
+{
+	enum SlotState : int { Disconnected, Idle, InUse, Checking };
+
+	struct Slot
+	{
+		std::atomic<int> state{ Disconnected };
+		T* connection = nullptr;
+		std::chrono::steady_clock::duration backoff{};
+		std::chrono::steady_clock::time_point nextAttempt{};
+	};
+
+public:
+	using Connect = std::function<T*()>; // nullptr when the connection fails
+	using HealthCheck = std::function<bool(T&)>;
+
+	struct Backoff
+	{
+		std::chrono::milliseconds initial{ 10 };
+		std::chrono::milliseconds max{ 1000 };
+	};
+
+	class Lease
+	{
+	public:
+		Lease(Lease&& other) noexcept : pool(other.pool), slot(other.slot), connection(other.connection)
+		{
+			other.pool = nullptr;
+		}
+
+		Lease(const Lease&) = delete;
+		Lease& operator=(const Lease&) = delete;
+		Lease& operator=(Lease&&) = delete;
+
+		~Lease()
+		{
+			if (pool)
+				pool->Return(*slot, Idle);
+		}
+
+		gsl::not_null<T*> get() const noexcept { return connection; }
+		T* operator->() const noexcept { return connection.get(); }
+
+		// the connection failed: it will be replaced in the background
+		void MarkBroken()
+		{
+			Expects(pool != nullptr);
+			pool->Return(*slot, Disconnected);
+			pool = nullptr;
+		}
+
+	private:
+		friend class ConnectionPool;
+		// a slot is claimed only once connected: no check
+		Lease(ConnectionPool& pool, Slot& slot) : pool(&pool), slot(&slot), connection(slot.connection, gsl::trusted) {}
+
+		ConnectionPool* pool;
+		Slot* slot;
+		gsl::not_null<T*> connection;
+	};
+
+	ConnectionPool(std::size_t capacity, Connect connect, HealthCheck healthCheck = nullptr, Backoff backoff = {})
+		: slots(capacity), connect(std::move(connect)), healthCheck(std::move(healthCheck)), backoff(backoff)
+	{
+		Expects(capacity > 0 && this->connect);
+		for (auto& slot : slots)
+			slot.backoff = backoff.initial;
+		maintainer = std::thread([this] { Maintain(); });
+	}
+
+	ConnectionPool(const ConnectionPool&) = delete;
+	ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+	// leases must be returned before
+	~ConnectionPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wakeUp.notify_one();
+		maintainer.join();
+	}
+
+	// throws if no healthy connection becomes available within timeout
+	Lease Checkout(std::chrono::milliseconds timeout)
+	{
+		const auto deadline = std::chrono::steady_clock::now() + timeout;
+		for (auto pause = std::chrono::microseconds(1);; pause = std::min(pause * 2, std::chrono::microseconds(1000)))
+		{
+			// start from a different slot each time, to spread the contention
+			const auto first = nextSlot.fetch_add(1, std::memory_order_relaxed);
+			for (std::size_t i = 0; i < slots.size(); ++i)
+			{
+				auto& slot = slots[(first + i) % slots.size()];
+				int expected = Idle;
+				if (slot.state.compare_exchange_strong(expected, InUse, std::memory_order_acquire))
+					return{ *this, slot };
+			}
+			if (std::chrono::steady_clock::now() >= deadline)
+				throw std::runtime_error("ConnectionPool: no healthy connection available");
+			std::this_thread::sleep_for(pause);
+		}
+	}
+
+	std::size_t Capacity() const noexcept { return slots.size(); }
+
+	std::size_t Connected() const noexcept
+	{
+		return static_cast<std::size_t>(std::count_if(begin(slots), end(slots), [](const Slot& slot) { return slot.state.load() != Disconnected; }));
+	}
+
+private:
+	void Return(Slot& slot, SlotState state)
+	{
+		slot.state.store(state, std::memory_order_release);
+		if (state == Disconnected)
+			wakeUp.notify_one();
+	}
+
+	void Maintain()
+	{
+		const auto healthCheckPeriod = std::chrono::milliseconds(100);
+		auto nextHealthCheck = std::chrono::steady_clock::now() + healthCheckPeriod;
+		std::unique_lock<std::mutex> lock(mutex);
+		while (!stopping)
+		{
+			lock.unlock();
+			auto now = std::chrono::steady_clock::now();
+			auto wakeAt = now + healthCheckPeriod;
+			for (auto& slot : slots)
+			{
+				if (slot.state.load(std::memory_order_acquire) == Disconnected)
+				{
+					if (now >= slot.nextAttempt)
+						Reconnect(slot, now);
+					if (slot.state.load() == Disconnected)
+						wakeAt = std::min(wakeAt, slot.nextAttempt);
+				}
+			}
+			if (healthCheck && now >= nextHealthCheck)
+			{
+				CheckIdle();
+				nextHealthCheck = now + healthCheckPeriod;
+			}
+			lock.lock();
+			wakeUp.wait_until(lock, wakeAt);
+		}
+	}
+
+	// only the maintainer thread touches Disconnected slots
+	void Reconnect(Slot& slot, std::chrono::steady_clock::time_point now)
+	{
+		T* connection = nullptr;
+		try
+		{
+			connection = connect();
+		}
+		catch (...)
+		{
+		}
+		if (!connection)
+		{
+			slot.nextAttempt = now + slot.backoff;
+			slot.backoff = std::min<std::chrono::steady_clock::duration>(slot.backoff * 2, backoff.max);
+			return;
+		}
+		slot.connection = connection;
+		slot.backoff = backoff.initial;
+		slot.state.store(Idle, std::memory_order_release);
+	}
+
+	void CheckIdle()
+	{
+		for (auto& slot : slots)
+		{
+			int expected = Idle;
+			if (!slot.state.compare_exchange_strong(expected, Checking, std::memory_order_acquire))
+				continue;
+			bool healthy = false;
+			try
+			{
+				healthy = healthCheck(*slot.connection);
+			}
+			catch (...)
+			{
+			}
+			slot.state.store(healthy ? Idle : Disconnected, std::memory_order_release);
+		}
+	}
+
+	std::vector<Slot> slots;
+	std::atomic<std::size_t> nextSlot{ 0 };
+	Connect connect;
+	HealthCheck healthCheck;
+	Backoff backoff;
+
+	std::mutex mutex;
+	std::condition_variable wakeUp;
+	bool stopping = false;
+	std::thread maintainer;
+};
@@ -0,0 +1,34 @@
+#pragma once
+#include "gsl.h"
+#include "intrusive_ptr.h"
+#include "string_view.h"
+#include <cstdint>
+#include <string>
+
+// opaque reference to a key, from IDataSource::Resolve
+struct KeyHandle
+{
+	std::uint32_t index;  // meaning is up to the data source
+	std::uint32_t keySet; // which key set the handle refers to
+};
+
+// reference counted: can be held by shared_ptr or by intrusive_ptr (see CreateLocalDataSource)
+class IDataSource : public ref_counted
+{
+public:
+	virtual ~IDataSource() = default;
+	virtual double Get(const std::string& key) = 0;
+
+	// resolve once, then Get(handle) skips hashing and comparing the key
+	virtual KeyHandle Resolve(experimental::string_view key) = 0;
+	virtual double Get(KeyHandle key) = 0;
+
+	// one virtual call for many keys: implementations can loop without dispatch
+	// (or prefetch), out[i] is the value of keys[i]
+	virtual void GetMany(gsl::span<const experimental::string_view> keys, gsl::span<double> out)
+	{
+		Expects(keys.size() == out.size());
+		for (std::ptrdiff_t i = 0; i < keys.size(); ++i)
+			out[i] = Get(std::string(keys[i].data(), keys[i].size()));
+	}
+};
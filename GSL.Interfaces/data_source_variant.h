@@ -0,0 +1,80 @@
+#pragma once
+#include "gsl.h"
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Closed set of data sources, chosen at run time but used with their static type
+//
+// CreateDataSource returns a shared_ptr<IDataSource>: every Get is a virtual call.
+// When the possible sources are known, DataSourceVariant<MemoryDataSource, EmptyDataSource>
+// stores one of them in place and Visit calls f with the concrete type. Visiting once
+// outside a hot loop (templated on the source) lets the compiler inline the Gets
+// (declare the sources final, so that calls through them are not virtual).
+template<typename... Sources>
+class DataSourceVariant
+{
+public:
+	template<typename Source, typename... Args>
+	static DataSourceVariant Make(Args&&... args)
+	{
+		DataSourceVariant variant;
+		new (&variant.storage) Source(std::forward<Args>(args)...);
+		variant.which = IndexOf<Source, Sources...>::value;
+		return variant;
+	}
+
+	DataSourceVariant(DataSourceVariant&& other)
+	{
+		other.Visit([this](auto& source) { new (&storage) std::decay_t<decltype(source)>(std::move(source)); });
+		which = other.which;
+	}
+
+	DataSourceVariant(const DataSourceVariant&) = delete;
+	DataSourceVariant& operator=(const DataSourceVariant&) = delete;
+	DataSourceVariant& operator=(DataSourceVariant&&) = delete;
+
+	~DataSourceVariant()
+	{
+		if (which != invalid)
+			Visit([](auto& source) { using Source = std::decay_t<decltype(source)>; source.~Source(); });
+	}
+
+	// f is called with the source actually stored (e.g. MemoryDataSource&)
+	template<typename F>
+	decltype(auto) Visit(F&& f)
+	{
+		using Result = decltype(f(std::declval<First&>()));
+		using Invoker = Result(*)(void*, F&);
+		static const Invoker invokers[] = { &Invoke<Sources, Result, F>... };
+		Expects(which != invalid);
+		return invokers[which](&storage, f);
+	}
+
+	std::size_t Index() const noexcept { return which; }
+
+private:
+	using First = std::tuple_element_t<0, std::tuple<Sources...>>;
+	static const std::size_t invalid = sizeof...(Sources);
+
+	template<typename T, typename... Ts>
+	struct IndexOf;
+
+	template<typename T, typename... Ts>
+	struct IndexOf<T, T, Ts...> : std::integral_constant<std::size_t, 0> {};
+
+	template<typename T, typename U, typename... Ts>
+	struct IndexOf<T, U, Ts...> : std::integral_constant<std::size_t, 1 + IndexOf<T, Ts...>::value> {};
+
+	template<typename Source, typename Result, typename F>
+	static Result Invoke(void* storage, F& f)
+	{
+		return f(*static_cast<Source*>(storage));
+	}
+
+	DataSourceVariant() = default;
+
+	std::aligned_union_t<0, Sources...> storage;
+	std::size_t which = invalid;
+};
@@ -0,0 +1,101 @@
+#pragma once
+#include "gsl.h"
+#include <cstdint>
+#include <limits>
+#include <random>
+
+// Fast pseudo-random numbers for simulations and fault injection
+//
+// std::random_device may read from the OS at each call: fine for a seed, too slow
+// for millions of draws. Xoshiro256 (xoshiro256**) is a small, fast and seedable
+// generator usable with the <random> distributions. FaultInjection draws failures
+// with a given probability, reproducibly from its seed.
+
+class Xoshiro256
+{
+public:
+	using result_type = std::uint64_t;
+
+	explicit Xoshiro256(std::uint64_t seed) noexcept
+	{
+		Seed(seed);
+	}
+
+	// expands the seed with splitmix64, as recommended by the authors
+	void Seed(std::uint64_t seed) noexcept
+	{
+		for (auto& word : state)
+		{
+			seed += 0x9E3779B97F4A7C15ull;
+			auto z = seed;
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+			word = z ^ (z >> 31);
+		}
+	}
+
+	static constexpr result_type min() noexcept { return 0; }
+	static constexpr result_type max() noexcept { return std::numeric_limits<result_type>::max(); }
+
+	result_type operator()() noexcept
+	{
+		const auto result = RotateLeft(state[1] * 5, 7) * 9;
+		const auto t = state[1] << 17;
+		state[2] ^= state[0];
+		state[3] ^= state[1];
+		state[1] ^= state[2];
+		state[0] ^= state[3];
+		state[2] ^= t;
+		state[3] = RotateLeft(state[3], 45);
+		return result;
+	}
+
+private:
+	static std::uint64_t RotateLeft(std::uint64_t x, int k) noexcept
+	{
+		return (x << k) | (x >> (64 - k));
+	}
+
+	std::uint64_t state[4];
+};
+
+// one generator per thread, seeded from std::random_device unless SeedThreadRandom is called
+inline Xoshiro256& ThreadRandom()
+{
+	static thread_local Xoshiro256 generator{ (static_cast<std::uint64_t>(std::random_device{}()) << 32) | std::random_device{}() };
+	return generator;
+}
+
+// makes the draws of the calling thread reproducible
+inline void SeedThreadRandom(std::uint64_t seed) noexcept
+{
+	ThreadRandom().Seed(seed);
+}
+
+// fails with probability failureRate: same seed, same sequence of failures
+// (not thread-safe: use one per thread, e.g. thread_local)
+class FaultInjection
+{
+public:
+	FaultInjection(double failureRate, std::uint64_t seed)
+		: generator(seed), threshold(ThresholdOf(failureRate)), always(failureRate >= 1.0)
+	{
+		Expects(failureRate >= 0.0 && failureRate <= 1.0);
+	}
+
+	bool Fails() noexcept
+	{
+		return generator() < threshold || always;
+	}
+
+private:
+	// failures are the draws below failureRate * 2^64
+	static std::uint64_t ThresholdOf(double failureRate) noexcept
+	{
+		return failureRate >= 1.0 ? Xoshiro256::max() : static_cast<std::uint64_t>(failureRate * 18446744073709551616.0);
+	}
+
+	Xoshiro256 generator;
+	std::uint64_t threshold;
+	bool always;
+};
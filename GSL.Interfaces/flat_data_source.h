@@ -0,0 +1,179 @@
+#pragma once
+#include "data_source.h"
+#include "string_view.h"
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Sorted keys packed in an arena, with their values in a parallel array
+//
+// This is only a view: the arrays may live in vectors (FlatDataSource) or in a mapped file
+// (MappedDataSource). Besides the key offsets, it keeps 8 characters of each key as an
+// integer (the first ones after the prefix all keys share, e.g. "sensor."), so that most
+// comparisons do not touch the arena.
+struct FlatKeyIndex
+{
+	using key_type = experimental::string_view;
+
+	const char* arena;
+	const std::uint64_t* offsets; // key i is arena[offsets[i], offsets[i+1])
+	const std::uint64_t* prefixes;
+	const double* values;
+	std::size_t count;
+	std::size_t commonPrefix;
+
+	key_type KeyAt(std::size_t idx) const noexcept
+	{
+		return{ arena + offsets[idx], static_cast<std::size_t>(offsets[idx + 1] - offsets[idx]) };
+	}
+
+	// 8 characters after the common prefix, big-endian and zero-padded:
+	// among keys starting with the common prefix, integer order agrees with string order
+	std::uint64_t PrefixOf(key_type key) const noexcept
+	{
+		std::uint64_t prefix = 0;
+		for (std::size_t i = commonPrefix; i < commonPrefix + 8; ++i)
+			prefix = (prefix << 8) | (i < key.size() ? static_cast<unsigned char>(key[i]) : 0u);
+		return prefix;
+	}
+
+	// index of key, or count if missing
+	// branchless binary search: each step picks the half with a conditional move
+	std::size_t Find(key_type key) const noexcept
+	{
+		auto n = count;
+		if (n == 0 || key.size() < commonPrefix || key.compare(0, commonPrefix, KeyAt(0), 0, commonPrefix) != 0)
+			return count;
+		const auto prefix = PrefixOf(key);
+		std::size_t base = 0;
+		while (n > 1)
+		{
+			const auto half = n / 2;
+			base = Less(base + half, key, prefix) ? base + half : base;
+			n -= half;
+		}
+		base += Less(base, key, prefix); // lower bound
+		return base < count && prefixes[base] == prefix && KeyAt(base) == key ? base : count;
+	}
+
+private:
+	bool Less(std::size_t idx, key_type key, std::uint64_t prefix) const noexcept
+	{
+		return prefixes[idx] < prefix || (prefixes[idx] == prefix && KeyAt(idx) < key);
+	}
+};
+
+// Read-only data source in contiguous memory
+//
+// map<string, double> allocates a node per key and chases pointers at every lookup.
+// Here keys are sorted and their characters packed one after the other in a single arena,
+// values live in a parallel array (see FlatKeyIndex). Lookups take string_view keys,
+// so literals and views do not create a temporary string.
+class FlatDataSource : public IDataSource
+{
+public:
+	using key_type = FlatKeyIndex::key_type;
+
+	// on duplicate keys, the first one wins
+	explicit FlatDataSource(std::vector<std::pair<std::string, double>> data)
+	{
+		std::stable_sort(begin(data), end(data), [](const auto& l, const auto& r) { return l.first < r.first; });
+		data.erase(std::unique(begin(data), end(data), [](const auto& l, const auto& r) { return l.first == r.first; }), end(data));
+
+		std::size_t arenaSize = 0;
+		for (const auto& entry : data)
+			arenaSize += entry.first.size();
+		arena.reserve(arenaSize);
+		offsets.reserve(data.size() + 1);
+		prefixes.reserve(data.size());
+		values.reserve(data.size());
+
+		// keys are sorted: the first and the last one share the prefix of all the others
+		if (!data.empty())
+		{
+			const auto& first = data.front().first;
+			const auto& last = data.back().first;
+			commonPrefix = std::mismatch(begin(first), begin(first) + std::min(first.size(), last.size()), begin(last)).first - begin(first);
+		}
+
+		offsets.push_back(0);
+		for (const auto& entry : data)
+		{
+			arena.insert(end(arena), begin(entry.first), end(entry.first));
+			offsets.push_back(arena.size());
+			prefixes.push_back(Index().PrefixOf(entry.first));
+			values.push_back(entry.second);
+		}
+	}
+
+	double Get(const std::string& key) override
+	{
+		return Get(key_type{ key });
+	}
+
+	// literals would otherwise pick Get(const std::string&) and build a temporary string:
+	// a non-const object makes it a better match than the const string_view overload
+	double Get(const char* key)
+	{
+		return Get(key_type{ key });
+	}
+
+	double Get(key_type key) const
+	{
+		const auto idx = Find(key);
+		if (idx == size())
+			throw std::out_of_range("FlatDataSource: key not found");
+		return values[idx];
+	}
+
+	KeyHandle Resolve(key_type key) override
+	{
+		const auto idx = Find(key);
+		if (idx == size())
+			throw std::out_of_range("FlatDataSource: key not found");
+		return{ gsl::narrow<std::uint32_t>(idx), 0 }; // the keys never change
+	}
+
+	double Get(KeyHandle key) override
+	{
+		Expects(key.index < size());
+		return values[key.index];
+	}
+
+	void GetMany(gsl::span<const key_type> keys, gsl::span<double> out) override
+	{
+		Expects(keys.size() == out.size());
+		for (std::ptrdiff_t i = 0; i < keys.size(); ++i)
+			out[i] = Get(keys[i]);
+	}
+
+	bool Contains(key_type key) const noexcept
+	{
+		return Find(key) != size();
+	}
+
+	std::size_t size() const noexcept { return values.size(); }
+
+	// index of key, or size() if missing
+	std::size_t Find(key_type key) const noexcept { return Index().Find(key); }
+
+	double ValueAt(std::size_t idx) const noexcept { return values[idx]; }
+
+	key_type KeyAt(std::size_t idx) const noexcept { return Index().KeyAt(idx); }
+
+	// the arrays, e.g. to save them (see mapped_data_source.h)
+	FlatKeyIndex Index() const noexcept
+	{
+		return{ arena.data(), offsets.data(), prefixes.data(), values.data(), values.size(), commonPrefix };
+	}
+
+private:
+	std::vector<char> arena;
+	std::size_t commonPrefix = 0;
+	std::vector<std::uint64_t> offsets;
+	std::vector<std::uint64_t> prefixes;
+	std::vector<double> values;
+};
@@ -1,6 +1,20 @@
 #include "gsl.h"
+#include "data_source.h"
+#include "flat_data_source.h"
+#include "snapshot_data_source.h"
+#include "mapped_data_source.h"
+#include "data_source_variant.h"
+#include "connection_pool.h"
+#include "fast_random.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <map>
 #include <random>
+#include <sstream>
+#include <string>
+#include <thread>
 #include <vector>
 #include <iostream>
 
@@ -22,45 +36,327 @@ string BuildString(gsl::not_null<const char*> str) // GSL declares also gsl::czs
 
 // Factory example
 
-class IDataSource
+class MemoryDataSource final : public IDataSource
 {
-public:
-	virtual ~IDataSource() = default;
-	virtual double Get(const string& key) = 0;
-};
+	// key -> position of its value, which is also its handle
+	// (less<> finds string_views without building strings)
+	map<string, uint32_t, less<>> index;
+	vector<double> values;
+	uint32_t keySet = 0;
 
-class MemoryDataSource : public IDataSource
-{
-	const map<string, double> data{
-		{ "param1"s, 1.0 }
-	};
+	uint32_t IndexOf(experimental::string_view key) const
+	{
+		auto it = index.find(key);
+		if (it == end(index))
+			throw out_of_range("MemoryDataSource: key not found");
+		return it->second;
+	}
 
 public:
+	MemoryDataSource()
+	{
+		Load({ { "param1"s, 1.0 } });
+	}
+
+	// reloading the same keys keeps the handles valid
+	void Load(const map<string, double>& snapshot)
+	{
+		const auto sameKeys = snapshot.size() == index.size() &&
+			equal(begin(snapshot), end(snapshot), begin(index), [](const auto& l, const auto& r) { return l.first == r.first; });
+		if (!sameKeys)
+		{
+			index.clear();
+			for (const auto& entry : snapshot)
+				index.emplace_hint(end(index), entry.first, narrow<uint32_t>(index.size()));
+			++keySet;
+		}
+		// both maps are sorted: positions follow the order of the keys
+		values.clear();
+		for (const auto& entry : snapshot)
+			values.push_back(entry.second);
+	}
+
 	double Get(const string & key) override
 	{
-		return data.at(key);
+		return values[IndexOf(key)];
+	}
+
+	KeyHandle Resolve(experimental::string_view key) override
+	{
+		return{ IndexOf(key), keySet };
+	}
+
+	double Get(KeyHandle key) override
+	{
+		Expects(key.keySet == keySet); // resolved against different keys
+		Expects(key.index < values.size()); // key sets are per instance: a handle of another source can match
+		return values[key.index];
+	}
+
+	void GetMany(span<const experimental::string_view> keys, span<double> out) override
+	{
+		Expects(keys.size() == out.size());
+		for (std::ptrdiff_t i = 0; i < keys.size(); ++i)
+			out[i] = values[IndexOf(keys[i])];
 	}
 };
 
-class EmptyDataSource : public IDataSource
+class EmptyDataSource final : public IDataSource
 {
 public:
 	double Get(const string & key) override
 	{
 		return 0.0;
 	}
+
+	KeyHandle Resolve(experimental::string_view) override
+	{
+		return{ 0, 0 };
+	}
+
+	double Get(KeyHandle) override
+	{
+		return 0.0;
+	}
+
+	void GetMany(span<const experimental::string_view> keys, span<double> out) override
+	{
+		Expects(keys.size() == out.size());
+		memset(out.data(), 0, out.size() * sizeof(double)); // all-zero bits is 0.0
+	}
 };
 
 // intent: CreateDataSource always returns a valid shared_ptr
-// note: formally this function can also throw an exception trying to
-// create a not_null from a nullptr
+// note: make_not_null_shared (see GSL-edited-files/gsl.h) skips the check,
+// since make_shared cannot return nullptr (it throws instead)
 gsl::not_null<std::shared_ptr<IDataSource>> CreateDataSource(const std::string& cmdLine)
 {
 	if (cmdLine.find_first_of("memory") == 0)
 	{
-		return make_shared<MemoryDataSource>();
+		return make_not_null_shared<MemoryDataSource>();
+	}
+	return make_not_null_shared<EmptyDataSource>();
+}
+
+// same choice, for sources that stay on the calling thread: copying the
+// handle updates a plain counter inside the source (see intrusive_ptr.h)
+using LocalDataSource = intrusive_ptr<IDataSource, thread_confined>;
+
+gsl::not_null<LocalDataSource> CreateLocalDataSource(const std::string& cmdLine)
+{
+	if (cmdLine.find_first_of("memory") == 0)
+	{
+		return make_not_null_intrusive<MemoryDataSource, thread_confined>();
+	}
+	return make_not_null_intrusive<EmptyDataSource, thread_confined>();
+}
+
+// same choice, without virtual calls: see DataSourceVariant
+using StaticDataSource = DataSourceVariant<MemoryDataSource, EmptyDataSource>;
+
+StaticDataSource CreateStaticDataSource(const std::string& cmdLine)
+{
+	if (cmdLine.find_first_of("memory") == 0)
+	{
+		return StaticDataSource::Make<MemoryDataSource>();
+	}
+	return StaticDataSource::Make<EmptyDataSource>();
+}
+
+// works with any source: with a concrete one, Get is inlined
+template<typename Source>
+double SumParameter(Source& source, KeyHandle key, int times)
+{
+	double sum = 0.0;
+	for (int i = 0; i < times; ++i)
+		sum += source.Get(key);
+	return sum;
+}
+
+// Flat data source example
+
+void call_flat_data_source()
+{
+	FlatDataSource source({ { "param2"s, 2.0 }, { "param1"s, 1.0 }, { "param10"s, 10.0 } });
+	cout << "param1: " << source.Get("param1") << " param10: " << source.Get("param10") << "\n"; // Get(const char*): no string temporaries
+	cout << "has param3: " << boolalpha << source.Contains("param3") << "\n";
+}
+
+// Batched lookup example
+
+void call_get_many()
+{
+	const experimental::string_view keys[]{ "param1", "param1" };
+	double values[2]{};
+	for (auto cmdLine : { "memory"s, "none"s })
+	{
+		auto source = CreateDataSource(cmdLine);
+		source->GetMany(keys, values); // a single virtual call
+		cout << cmdLine << ": " << values[0] << " " << values[1] << "\n";
 	}
-	return make_shared<EmptyDataSource>();
+}
+
+// Key handles example
+
+void call_key_handles()
+{
+	MemoryDataSource source;
+	const auto param1 = source.Resolve("param1");
+	cout << "param1: " << source.Get(param1) << "\n";
+
+	source.Load({ { "param1"s, 1.5 } }); // same keys: param1 is still valid
+	cout << "param1 reloaded: " << source.Get(param1) << "\n";
+}
+
+// Hot reload example
+
+void call_snapshot_data_source()
+{
+	SnapshotDataSource source({ { "param1"s, 1.0 } });
+	const auto param1 = source.Resolve("param1");
+
+	// readers never wait for the reloads
+	atomic<bool> reloading{ true };
+	atomic<long long> reads{ 0 };
+	vector<thread> readers;
+	for (int i = 0; i < 4; ++i)
+	{
+		readers.emplace_back([&] {
+			long long count = 0;
+			while (reloading)
+				count += source.Get(param1) > 0.0;
+			reads += count;
+		});
+	}
+	for (int version = 2; version <= 10; ++version)
+	{
+		this_thread::sleep_for(chrono::milliseconds(1));
+		source.Load({ { "param1"s, double(version) } }); // same keys: param1 is still valid
+	}
+	reloading = false;
+	for (auto& t : readers)
+		t.join();
+	cout << "param1 after reloads: " << source.Get("param1"s) << " (" << reads << " concurrent reads)\n";
+}
+
+// Mapped data source example
+
+void call_mapped_data_source()
+{
+	SaveMappedDataSource({ { "param1"s, 1.0 }, { "param2"s, 2.0 } }, "params.bin");
+	{
+		MappedDataSource source("params.bin");
+		cout << "mapped param2: " << source.Get("param2") << "\n";
+	}
+	remove("params.bin");
+}
+
+template<typename F>
+long long measure_ms(F f)
+{
+	const auto start = chrono::steady_clock::now();
+	f();
+	return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+}
+
+void benchmark_data_sources()
+{
+	mt19937 gen(42);
+	const int lookups = 1000000;
+	for (int keys = 1000; keys <= 1000000; keys *= 10)
+	{
+		vector<pair<string, double>> data;
+		for (int i = 0; i < keys; ++i)
+			data.emplace_back("sensor." + to_string(gen()) + ".value", i);
+		const map<string, double> tree(begin(data), end(data));
+		const FlatDataSource flat(data);
+
+		// call sites holding views (e.g. parsed from a buffer)
+		uniform_int_distribution<int> pick(0, keys - 1);
+		vector<experimental::string_view> queries;
+		for (int i = 0; i < lookups; ++i)
+			queries.emplace_back(data[pick(gen)].first);
+
+		double sum = 0.0;
+		const auto treeMs = measure_ms([&] {
+			for (auto key : queries)
+				sum += tree.at(string(key.data(), key.size()));
+		});
+		const auto flatMs = measure_ms([&] {
+			for (auto key : queries)
+				sum += flat.Get(key);
+		});
+		cout << keys << " keys: map " << treeMs << " ms, flat " << flatMs << " ms (" << sum << ")\n";
+	}
+}
+
+void benchmark_key_handles()
+{
+	const int lookups = 10000000;
+	MemoryDataSource source;
+	map<string, double> snapshot;
+	for (int i = 0; i < 1000; ++i)
+		snapshot.emplace("param" + to_string(i), i);
+	source.Load(snapshot);
+
+	double sum = 0.0;
+	const auto byName = measure_ms([&] {
+		for (int i = 0; i < lookups; ++i)
+			sum += source.Get("param500"s);
+	});
+	const auto handle = source.Resolve("param500");
+	const auto byHandle = measure_ms([&] {
+		for (int i = 0; i < lookups; ++i)
+			sum += source.Get(handle);
+	});
+	cout << "by name " << byName << " ms, by handle " << byHandle << " ms (" << sum << ")\n";
+}
+
+void benchmark_mapped_startup()
+{
+	const int keys = 1000000;
+	ostringstream text;
+	for (int i = 0; i < keys; ++i)
+		text << "param" << i << " " << i * 0.5 << "\n";
+	const auto lines = text.str();
+
+	map<string, double> parsed;
+	const auto parseMs = measure_ms([&] {
+		istringstream in(lines);
+		string key;
+		double value;
+		while (in >> key >> value)
+			parsed.emplace(key, value);
+	});
+	SaveMappedDataSource(parsed, "params.bin");
+
+	double sum = 0.0;
+	const auto verifiedMs = measure_ms([&] {
+		MappedDataSource source("params.bin");
+		sum += source.Get("param42");
+	});
+	const auto skippedMs = measure_ms([&] {
+		MappedDataSource source("params.bin", MappedDataSource::Checksum::Skip);
+		sum += source.Get("param42");
+	});
+	remove("params.bin");
+	cout << keys << " keys: text " << parseMs << " ms, mapped " << verifiedMs << " ms (" << skippedMs << " ms without checksum) (" << sum << ")\n";
+}
+
+void benchmark_static_data_source()
+{
+	const int lookups = 100000000;
+	double sum = 0.0;
+	const auto virtualMs = measure_ms([&] {
+		auto source = CreateDataSource("memory");
+		sum += SumParameter(*source.get(), source->Resolve("param1"), lookups); // IDataSource&
+	});
+	const auto staticMs = measure_ms([&] {
+		auto source = CreateStaticDataSource("memory");
+		// visit once, outside the loop
+		sum += source.Visit([](auto& concrete) { return SumParameter(concrete, concrete.Resolve("param1"), lookups); });
+	});
+	cout << "factory " << virtualMs << " ms, variant " << staticMs << " ms (" << sum << ")\n";
 }
 
 // not_null as *barrier*
@@ -73,14 +369,13 @@ struct Service
 	}
 };
 
-Service* GetService()
+// connectionFaults decides whether the connection fails: tests pass a seeded one
+Service* GetService(FaultInjection& connectionFaults)
 {
 	// suppose it performs a connection to something
 	// so it can return nullptr...
 	static Service s;
-	std::random_device rd;
-	uniform_int_distribution<int> success(0,5);
-	if (success(rd)) // connection granted?
+	if (!connectionFaults.Fails()) // connection granted?
 	{
 		return &s;
 	}
@@ -106,16 +401,166 @@ void Safe_UseService(not_null<Service*> service)
 // *shouldn't* handle nullptr service...(see main)
 void Safe_UseService(Service& service)
 {
-	service.Do();
+	Safe_UseService(not_null_from(service)); // a reference cannot be null: no check
 }
 
-int main()
+// Fault injection example
+
+void call_fault_injection()
 {
+	// same seed, same failures: simulations can be replayed
+	FaultInjection first(0.1, 42), second(0.1, 42);
+	int failures = 0, mismatches = 0;
+	for (int i = 0; i < 1000000; ++i)
+	{
+		const auto fails = first.Fails();
+		failures += fails;
+		mismatches += fails != second.Fails();
+	}
+	cout << "failures: " << failures << " mismatches: " << mismatches << "\n";
+}
+
+// passes the source down a few layers, by value
+template<typename Ptr>
+double Fetch3(Ptr source, KeyHandle key) { return source->Get(key); }
+
+template<typename Ptr>
+double Fetch2(Ptr source, KeyHandle key) { return Fetch3(std::move(source), key); }
+
+template<typename Ptr>
+double Fetch1(Ptr source, KeyHandle key) { return Fetch2(std::move(source), key); }
+
+// MemoryDataSource is final: the calls are not virtual, only the pointer handling is measured
+void benchmark_not_null()
+{
+	const int calls = 100000000;
+	MemoryDataSource source;
+	MemoryDataSource* raw = &source;
+	const auto key = source.Resolve("param1");
+
+	double sum = 0.0;
+	const auto rawMs = measure_ms([&] {
+		for (int i = 0; i < calls; ++i)
+			sum += Fetch1(raw, key);
+	});
+	const auto checkedMs = measure_ms([&] {
+		for (int i = 0; i < calls; ++i)
+			sum += Fetch1(not_null<MemoryDataSource*>(raw), key);
+	});
+	const auto trustedMs = measure_ms([&] {
+		for (int i = 0; i < calls; ++i)
+			sum += Fetch1(not_null<MemoryDataSource*>(raw, trusted), key);
+	});
+	cout << "raw " << rawMs << " ms, not_null checked " << checkedMs << " ms, trusted " << trustedMs
+		<< " ms (" << sum << ")\n";
+}
+
+void call_local_data_source()
+{
+	auto source = CreateLocalDataSource("memory");
+	{
+		auto copy = source; // no atomic operation
+		cout << "references: " << copy.get().use_count() << "\n";
+	}
+	cout << "references: " << source.get().use_count() << " param1: " << source->Get("param1"s) << "\n";
+}
+
+// one copy per layer: the refcount updates are most of the cost
+void benchmark_intrusive_ptr()
+{
+	const int calls = 100000000;
+	auto shared = CreateDataSource("memory");
+	auto local = CreateLocalDataSource("memory");
+	not_null<intrusive_ptr<IDataSource>> atomic = make_not_null_intrusive<MemoryDataSource>();
+	const auto key = shared->Resolve("param1");
+
+	double sum = 0.0;
+	const auto sharedMs = measure_ms([&] {
+		for (int i = 0; i < calls; ++i)
+			sum += Fetch1(shared, key);
+	});
+	const auto atomicMs = measure_ms([&] {
+		for (int i = 0; i < calls; ++i)
+			sum += Fetch1(atomic, key);
+	});
+	const auto localMs = measure_ms([&] {
+		for (int i = 0; i < calls; ++i)
+			sum += Fetch1(local, key);
+	});
+	cout << "not_null<shared_ptr> " << sharedMs << " ms, intrusive_ptr<thread_safe> " << atomicMs
+		<< " ms, intrusive_ptr<thread_confined> " << localMs << " ms (" << sum << ")\n";
+}
+
+void benchmark_fault_injection()
+{
+	const int connections = 1000000;
+	int granted = 0;
+	const auto randomDeviceMs = measure_ms([&] {
+		for (int i = 0; i < connections; ++i)
+		{
+			std::random_device rd;
+			uniform_int_distribution<int> success(0, 5);
+			granted += success(rd) != 0;
+		}
+	});
+	FaultInjection faults(1.0 / 6, 42);
+	const auto faultInjectionMs = measure_ms([&] {
+		for (int i = 0; i < connections; ++i)
+			granted += !faults.Fails();
+	});
+	cout << connections << " connections: random_device " << randomDeviceMs << " ms, FaultInjection " << faultInjectionMs << " ms (" << granted << ")\n";
+}
+
+// Connection pool example
+
+void call_connection_pool()
+{
+	// fake service failing to connect half of the times
+	Service service;
+	mt19937 gen(42);
+	bernoulli_distribution fails(0.5);
+	ConnectionPool<Service> pool(4, [&]() -> Service* { return fails(gen) ? nullptr : &service; });
+
+	// connections are made in the background: requests only wait for a free one
+	for (int i = 0; i < 3; ++i)
+	{
+		auto lease = pool.Checkout(chrono::seconds(1));
+		Safe_UseService(lease.get());
+	}
+	pool.Checkout(chrono::seconds(1)).MarkBroken(); // replaced in the background
+	cout << "connected: " << pool.Connected() << "/" << pool.Capacity() << "\n";
+}
+
+int main(int argc, char* argv[])
+{
+	call_flat_data_source();
+	call_get_many();
+	call_key_handles();
+	call_snapshot_data_source();
+	call_mapped_data_source();
+	call_connection_pool();
+	call_fault_injection();
+	call_local_data_source();
+
+	// run with "bench" to measure (it takes a while)
+	if (argc > 1 && argv[1] == "bench"s)
+	{
+		benchmark_data_sources();
+		benchmark_key_handles();
+		benchmark_mapped_startup();
+		benchmark_static_data_source();
+		benchmark_fault_injection();
+		benchmark_not_null();
+		benchmark_intrusive_ptr();
+		return 0;
+	}
+
 	Service* s = nullptr;
 	Safe_UseService(*s); // undefined behavior
 
 	// not_null<Service*> s = nullptr; // cannot compile
-	not_null<Service*> ns = GetService(); // run-time check
+	FaultInjection connectionFaults(1.0 / 6, ThreadRandom()()); // SeedThreadRandom before, to replay
+	not_null<Service*> ns = GetService(connectionFaults); // run-time check
 	// kind of a *barrier*
 
 	Safe_UseService(*ns); // if we get here, s.get() is not null
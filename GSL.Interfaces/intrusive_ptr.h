@@ -0,0 +1,180 @@
+#pragma once
+#include "gsl.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+// Intrusive reference counting
+//
+// shared_ptr keeps its count in a separate control block and always updates it atomically.
+// Here objects deriving from ref_counted carry their own count and the pointer type chooses
+// how to update it:
+// - intrusive_ptr<T, thread_safe>: atomic increments/decrements, like shared_ptr
+// - intrusive_ptr<T, thread_confined>: plain increments/decrements, for objects that
+//   never leave one thread (copying such a pointer costs as much as copying an int)
+// Do not mix the two policies on the same object across threads.
+// intrusive_ptr can be assigned nullptr, thus it works with not_null.
+
+struct thread_safe
+{
+	static void increment(std::atomic<std::uint32_t>& count) noexcept
+	{
+		count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// true when the last reference goes away
+	static bool decrement(std::atomic<std::uint32_t>& count) noexcept
+	{
+		return count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+	}
+};
+
+struct thread_confined
+{
+	// relaxed load and store: no locked instructions
+	static void increment(std::atomic<std::uint32_t>& count) noexcept
+	{
+		count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	static bool decrement(std::atomic<std::uint32_t>& count) noexcept
+	{
+		const auto left = count.load(std::memory_order_relaxed) - 1;
+		count.store(left, std::memory_order_relaxed);
+		return left == 0;
+	}
+};
+
+class ref_counted
+{
+public:
+	virtual ~ref_counted() = default;
+
+protected:
+	ref_counted() noexcept = default;
+
+	// copies are new objects: they start with no references
+	ref_counted(const ref_counted&) noexcept {}
+	ref_counted& operator=(const ref_counted&) noexcept { return *this; }
+
+private:
+	template<typename T, typename Policy>
+	friend class intrusive_ptr;
+
+	mutable std::atomic<std::uint32_t> refs{ 0 };
+};
+
+template<typename T, typename Policy = thread_safe>
+class intrusive_ptr
+{
+public:
+	using element_type = T;
+
+	intrusive_ptr() noexcept = default;
+	intrusive_ptr(std::nullptr_t) noexcept {}
+
+	// takes a reference to *ptr* (fresh objects start from zero)
+	explicit intrusive_ptr(T* ptr) noexcept : ptr_(ptr)
+	{
+		AddRef();
+	}
+
+	intrusive_ptr(const intrusive_ptr& other) noexcept : ptr_(other.ptr_)
+	{
+		AddRef();
+	}
+
+	intrusive_ptr(intrusive_ptr&& other) noexcept : ptr_(other.ptr_)
+	{
+		other.ptr_ = nullptr;
+	}
+
+	template<typename U, typename Dummy = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+	intrusive_ptr(const intrusive_ptr<U, Policy>& other) noexcept : ptr_(other.get())
+	{
+		AddRef();
+	}
+
+	template<typename U, typename Dummy = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+	intrusive_ptr(intrusive_ptr<U, Policy>&& other) noexcept : ptr_(other.release())
+	{
+	}
+
+	~intrusive_ptr()
+	{
+		Release();
+	}
+
+	intrusive_ptr& operator=(intrusive_ptr other) noexcept
+	{
+		std::swap(ptr_, other.ptr_);
+		return *this;
+	}
+
+	intrusive_ptr& operator=(std::nullptr_t) noexcept
+	{
+		Release();
+		ptr_ = nullptr;
+		return *this;
+	}
+
+	T* get() const noexcept { return ptr_; }
+	T* operator->() const noexcept { return ptr_; }
+	T& operator*() const noexcept { return *ptr_; }
+	explicit operator bool() const noexcept { return ptr_ != nullptr; }
+
+	// gives up the reference without releasing it
+	T* release() noexcept
+	{
+		auto ptr = ptr_;
+		ptr_ = nullptr;
+		return ptr;
+	}
+
+	std::uint32_t use_count() const noexcept
+	{
+		return ptr_ ? static_cast<const ref_counted*>(ptr_)->refs.load(std::memory_order_relaxed) : 0;
+	}
+
+private:
+	void AddRef() const noexcept
+	{
+		if (ptr_)
+			Policy::increment(static_cast<const ref_counted*>(ptr_)->refs);
+	}
+
+	void Release() noexcept
+	{
+		if (ptr_ && Policy::decrement(static_cast<const ref_counted*>(ptr_)->refs))
+			delete static_cast<const ref_counted*>(ptr_);
+	}
+
+	T* ptr_ = nullptr;
+};
+
+template<typename T, typename U, typename Policy>
+bool operator==(const intrusive_ptr<T, Policy>& l, const intrusive_ptr<U, Policy>& r) noexcept { return l.get() == r.get(); }
+
+template<typename T, typename U, typename Policy>
+bool operator!=(const intrusive_ptr<T, Policy>& l, const intrusive_ptr<U, Policy>& r) noexcept { return l.get() != r.get(); }
+
+template<typename T, typename Policy>
+bool operator==(const intrusive_ptr<T, Policy>& l, std::nullptr_t) noexcept { return !l; }
+
+template<typename T, typename Policy>
+bool operator!=(const intrusive_ptr<T, Policy>& l, std::nullptr_t) noexcept { return static_cast<bool>(l); }
+
+template<typename T, typename Policy = thread_safe, typename... Args>
+intrusive_ptr<T, Policy> make_intrusive(Args&&... args)
+{
+	return intrusive_ptr<T, Policy>{ new T(std::forward<Args>(args)...) };
+}
+
+// new either succeeds or throws: no check
+template<typename T, typename Policy = thread_safe, typename... Args>
+gsl::not_null<intrusive_ptr<T, Policy>> make_not_null_intrusive(Args&&... args)
+{
+	return{ make_intrusive<T, Policy>(std::forward<Args>(args)...), gsl::trusted };
+}
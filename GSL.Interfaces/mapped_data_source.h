@@ -0,0 +1,275 @@
+#pragma once
+#include "flat_data_source.h"
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Persistent data source format, to be mapped in memory as is
+//
+//   MappedHeader
+//   uint64_t offsets[count + 1]   } the arrays of FlatKeyIndex,
+//   uint64_t prefixes[count]      } in the byte order of the writer (byteOrder)
+//   double   values[count]        }
+//   char     arena[arenaSize]     }
+//
+// The header is 48 bytes and the arrays 8-byte elements, so that all of them are aligned
+// in the mapping. The checksum (FNV-1a) covers everything after the header.
+struct MappedHeader
+{
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t byteOrder; // mapped_format::byte_order as written: files are not portable across endianness
+	std::uint64_t count;
+	std::uint64_t commonPrefix;
+	std::uint64_t arenaSize;
+	std::uint64_t checksum;
+};
+
+namespace mapped_format
+{
+	const char magic[8] = { 'G', 'S', 'L', 'P', 'A', 'R', 'A', 'M' };
+	const std::uint32_t version = 2;
+	const std::uint32_t byte_order = 0x01020304;
+	const std::uint64_t fnv_offset_basis = 14695981039346656037ull;
+
+	inline std::uint64_t fnv1a(const char* data, std::size_t size, std::uint64_t hash = fnv_offset_basis) noexcept
+	{
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			hash ^= static_cast<unsigned char>(data[i]);
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+}
+
+// converter: writes *data* in the format above
+inline void SaveMappedDataSource(const std::map<std::string, double>& data, const std::string& path)
+{
+	const FlatDataSource source({ begin(data), end(data) });
+	const auto index = source.Index();
+	const auto count = index.count;
+
+	const std::pair<const char*, std::size_t> arrays[] = {
+		{ reinterpret_cast<const char*>(index.offsets), (count + 1) * sizeof(std::uint64_t) },
+		{ reinterpret_cast<const char*>(index.prefixes), count * sizeof(std::uint64_t) },
+		{ reinterpret_cast<const char*>(index.values), count * sizeof(double) },
+		{ index.arena, static_cast<std::size_t>(index.offsets[count]) },
+	};
+
+	MappedHeader header{};
+	std::memcpy(header.magic, mapped_format::magic, sizeof(header.magic));
+	header.version = mapped_format::version;
+	header.byteOrder = mapped_format::byte_order;
+	header.count = count;
+	header.commonPrefix = index.commonPrefix;
+	header.arenaSize = index.offsets[count];
+	header.checksum = mapped_format::fnv_offset_basis;
+	for (const auto& array : arrays)
+		header.checksum = mapped_format::fnv1a(array.first, array.second, header.checksum);
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	for (const auto& array : arrays)
+		file.write(array.first, array.second);
+	if (!file)
+		throw std::runtime_error("SaveMappedDataSource: cannot write " + path);
+}
+
+// read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+	explicit MappedFile(const std::string& path)
+	{
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		LARGE_INTEGER fileSize;
+		if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize))
+			Fail(path);
+		length = static_cast<std::size_t>(fileSize.QuadPart);
+		if (length == 0)
+			return;
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping)
+			Fail(path);
+		address = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (!address)
+			Fail(path);
+#else
+		const auto fd = open(path.c_str(), O_RDONLY);
+		struct stat info;
+		if (fd == -1 || fstat(fd, &info) == -1)
+		{
+			if (fd != -1)
+				close(fd);
+			Fail(path);
+		}
+		length = static_cast<std::size_t>(info.st_size);
+		void* ptr = length ? mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+		close(fd); // the mapping keeps the file open
+		if (ptr == MAP_FAILED)
+			Fail(path);
+		address = static_cast<const char*>(ptr);
+#endif
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile()
+	{
+		Release();
+	}
+
+	const char* data() const noexcept { return address; }
+	std::size_t size() const noexcept { return length; }
+
+private:
+	[[noreturn]] void Fail(const std::string& path)
+	{
+		Release();
+		throw std::runtime_error("MappedFile: cannot map " + path);
+	}
+
+	void Release() noexcept
+	{
+#ifdef _WIN32
+		if (address)
+			UnmapViewOfFile(address);
+		if (mapping)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+#else
+		if (address)
+			munmap(const_cast<char*>(address), length);
+#endif
+	}
+
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#endif
+	const char* address = nullptr;
+	std::size_t length = 0;
+};
+
+// Data source serving a file written by SaveMappedDataSource straight from its mapping
+//
+// Opening checks the header and the key offsets against the size of the file (and, unless
+// skipped, the checksum): no parsing nor allocations, the values and the arena are loaded
+// by the OS on first access. Even with Checksum::Skip, a truncated or corrupt file cannot
+// make lookups read outside the mapping.
+class MappedDataSource : public IDataSource
+{
+public:
+	enum class Checksum { Verify, Skip };
+
+	using key_type = FlatKeyIndex::key_type;
+
+	explicit MappedDataSource(const std::string& path, Checksum checksum = Checksum::Verify)
+		: file(path)
+	{
+		MappedHeader header;
+		if (file.size() < sizeof(header))
+			throw std::runtime_error("MappedDataSource: truncated " + path);
+		std::memcpy(&header, file.data(), sizeof(header));
+		if (std::memcmp(header.magic, mapped_format::magic, sizeof(header.magic)) != 0 || header.version != mapped_format::version)
+			throw std::runtime_error("MappedDataSource: unknown format " + path);
+		if (header.byteOrder != mapped_format::byte_order)
+			throw std::runtime_error("MappedDataSource: written with another byte order " + path);
+
+		// sizes are checked before multiplying, so that they cannot overflow
+		const auto payload = file.size() - sizeof(header);
+		if (header.count > payload / 24 || header.arenaSize > payload || (3 * header.count + 1) * 8 + header.arenaSize != payload)
+			throw std::runtime_error("MappedDataSource: truncated " + path);
+
+		const auto arrays = file.data() + sizeof(header);
+		if (checksum == Checksum::Verify && mapped_format::fnv1a(arrays, payload) != header.checksum)
+			throw std::runtime_error("MappedDataSource: checksum mismatch " + path);
+
+		const auto count = static_cast<std::size_t>(header.count);
+		const auto offsets = reinterpret_cast<const std::uint64_t*>(arrays);
+		if (!ValidOffsets(offsets, count, header.arenaSize, header.commonPrefix))
+			throw std::runtime_error("MappedDataSource: corrupt key offsets " + path);
+
+		const auto prefixes = offsets + count + 1;
+		const auto values = reinterpret_cast<const double*>(prefixes + count);
+		const auto arena = reinterpret_cast<const char*>(values + count);
+		index = { arena, offsets, prefixes, values, count, static_cast<std::size_t>(header.commonPrefix) };
+	}
+
+	double Get(const std::string& key) override
+	{
+		return Get(key_type{ key });
+	}
+
+	// see FlatDataSource::Get(const char*)
+	double Get(const char* key)
+	{
+		return Get(key_type{ key });
+	}
+
+	double Get(key_type key) const
+	{
+		const auto idx = index.Find(key);
+		if (idx == index.count)
+			throw std::out_of_range("MappedDataSource: key not found");
+		return index.values[idx];
+	}
+
+	KeyHandle Resolve(key_type key) override
+	{
+		const auto idx = index.Find(key);
+		if (idx == index.count)
+			throw std::out_of_range("MappedDataSource: key not found");
+		return{ gsl::narrow<std::uint32_t>(idx), 0 }; // the keys never change
+	}
+
+	double Get(KeyHandle key) override
+	{
+		Expects(key.index < index.count);
+		return index.values[key.index];
+	}
+
+	void GetMany(gsl::span<const key_type> keys, gsl::span<double> out) override
+	{
+		Expects(keys.size() == out.size());
+		for (std::ptrdiff_t i = 0; i < keys.size(); ++i)
+			out[i] = Get(keys[i]);
+	}
+
+	std::size_t size() const noexcept { return index.count; }
+
+private:
+	// keys within the arena, in order, and at least as long as their common prefix: O(count), no hashing
+	static bool ValidOffsets(const std::uint64_t* offsets, std::size_t count, std::uint64_t arenaSize, std::uint64_t commonPrefix) noexcept
+	{
+		if (offsets[0] != 0 || offsets[count] != arenaSize)
+			return false;
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			if (offsets[i + 1] < offsets[i] || offsets[i + 1] - offsets[i] < commonPrefix)
+				return false;
+		}
+		return true;
+	}
+
+	MappedFile file;
+	FlatKeyIndex index;
+};
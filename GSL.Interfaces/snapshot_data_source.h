@@ -0,0 +1,149 @@
+#pragma once
+#include "flat_data_source.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Hot-reloadable data source, RCU style
+//
+// Each Load builds an immutable snapshot (a FlatDataSource) and publishes it through
+// an atomic pointer. Readers never lock nor wait: they only announce themselves in the
+// counter of the current epoch, load the pointer and leave.
+// The writer retires the old snapshot after a grace period: it moves readers to a new
+// epoch and waits for the counters of the old one to drain (twice, since a reader may
+// read the epoch just before the switch). Hence reload latency is bounded by the
+// longest read in progress, and snapshots are deleted by the writer only.
+class SnapshotDataSource : public IDataSource
+{
+	struct Snapshot
+	{
+		FlatDataSource data;
+		std::uint32_t keySet;
+	};
+
+	using key_type = FlatDataSource::key_type;
+	static const std::size_t slotCount = 16;
+
+	// readers are spread over slots to avoid contending a single cache line
+	struct alignas(64) Slot
+	{
+		std::atomic<std::uint64_t> readers[2] = { { 0 }, { 0 } };
+	};
+
+	template<typename F>
+	decltype(auto) ReadSnapshot(F f) const
+	{
+		auto& counter = slots[ThreadSlot()].readers[epoch.load() & 1];
+		++counter;
+		auto leave = gsl::finally([&] { --counter; });
+		return f(*current.load());
+	}
+
+	static std::size_t ThreadSlot() noexcept
+	{
+		static std::atomic<std::size_t> nextSlot{ 0 };
+		static thread_local const std::size_t slot = nextSlot++ % slotCount;
+		return slot;
+	}
+
+public:
+	explicit SnapshotDataSource(std::vector<std::pair<std::string, double>> data = {})
+	{
+		Load(std::move(data));
+	}
+
+	SnapshotDataSource(const SnapshotDataSource&) = delete;
+	SnapshotDataSource& operator=(const SnapshotDataSource&) = delete;
+
+	~SnapshotDataSource()
+	{
+		delete current.load();
+	}
+
+	// handles resolved before stay valid if the keys are the same
+	void Load(std::vector<std::pair<std::string, double>> data)
+	{
+		std::unique_ptr<Snapshot> next(new Snapshot{ FlatDataSource{ std::move(data) }, 0 });
+
+		std::lock_guard<std::mutex> lock(writer);
+		std::unique_ptr<const Snapshot> previous(current.load());
+		next->keySet = previous ? (SameKeys(previous->data, next->data) ? previous->keySet : previous->keySet + 1) : 0;
+		current.store(next.release());
+		if (previous)
+			Synchronize();
+	}
+
+	// reads a consistent snapshot: f gets a const FlatDataSource&
+	template<typename F>
+	decltype(auto) Read(F f) const
+	{
+		return ReadSnapshot([&](const Snapshot& snapshot) -> decltype(auto) { return f(snapshot.data); });
+	}
+
+	double Get(const std::string& key) override
+	{
+		return Read([&](const FlatDataSource& data) { return data.Get(key_type{ key }); });
+	}
+
+	KeyHandle Resolve(experimental::string_view key) override
+	{
+		return ReadSnapshot([&](const Snapshot& snapshot) {
+			const auto idx = snapshot.data.Find(key);
+			if (idx == snapshot.data.size())
+				throw std::out_of_range("SnapshotDataSource: key not found");
+			return KeyHandle{ gsl::narrow<std::uint32_t>(idx), snapshot.keySet };
+		});
+	}
+
+	double Get(KeyHandle key) override
+	{
+		return ReadSnapshot([&](const Snapshot& snapshot) {
+			Expects(key.keySet == snapshot.keySet); // resolved against different keys
+			Expects(key.index < snapshot.data.size()); // key sets are per instance: a handle of another source can match
+			return snapshot.data.ValueAt(key.index);
+		});
+	}
+
+	void GetMany(gsl::span<const experimental::string_view> keys, gsl::span<double> out) override
+	{
+		Expects(keys.size() == out.size());
+		Read([&](const FlatDataSource& data) {
+			for (std::ptrdiff_t i = 0; i < keys.size(); ++i)
+				out[i] = data.Get(keys[i]);
+		});
+	}
+
+private:
+	static bool SameKeys(const FlatDataSource& l, const FlatDataSource& r) noexcept
+	{
+		if (l.size() != r.size())
+			return false;
+		for (std::size_t i = 0; i < l.size(); ++i)
+		{
+			if (l.KeyAt(i) != r.KeyAt(i))
+				return false;
+		}
+		return true;
+	}
+
+	// waits until no reader can still see the snapshot replaced before the call
+	void Synchronize()
+	{
+		for (int flip = 0; flip < 2; ++flip)
+		{
+			const auto old = epoch.fetch_add(1) & 1;
+			for (auto& slot : slots)
+			{
+				while (slot.readers[old].load() != 0)
+					std::this_thread::yield();
+			}
+		}
+	}
+
+	std::atomic<const Snapshot*> current{ nullptr };
+	std::atomic<std::uint64_t> epoch{ 0 };
+	mutable std::array<Slot, slotCount> slots;
+	std::mutex writer;
+};
@@ -1,7 +1,13 @@
 #include "gsl.h"
 #include "span.h"
 #include "gsl_util.h"
+#include "scope_profiler.h"
+#include "token_pool.h"
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <stdexcept>
+#include <thread>
 #include <vector>
 
 using namespace std;
@@ -20,6 +26,71 @@ void LogThisFunctionExit()
 	cout << "Still running...";
 }
 
+// the same idea, to measure: PROFILE_SCOPE records the name and the duration of the
+// function into a per-thread buffer (see scope_profiler.h), instead of printing
+double ProfiledStep(int i)
+{
+	PROFILE_SCOPE();
+	return sqrt(static_cast<double>(i));
+}
+
+double ProfiledWork(int steps)
+{
+	PROFILE_SCOPE();
+	double sum = 0.0;
+	for (int i = 0; i < steps; ++i)
+		sum += ProfiledStep(i);
+	return sum;
+}
+
+// writes a Chrome trace to *tracePath*, if any
+void call_scope_profiler(const char* tracePath)
+{
+	profiler::Profiler::Options options;
+	options.maxTraceEvents = 100000;
+	profiler::Profiler profiler(options);
+
+	double sum = 0.0;
+	thread worker([] { ProfiledWork(1000); });
+	for (int i = 0; i < 10; ++i)
+		sum += ProfiledWork(100);
+	worker.join();
+
+	profiler.Stop();
+	profiler.Report(cout);
+	if (tracePath)
+		profiler.WriteChromeTrace(tracePath); // open with chrome://tracing
+	cout << "sum: " << sum << "\n";
+}
+
+void benchmark_scope_profiler()
+{
+	profiler::Profiler profiler;
+	const int batches = 1000;
+	const int scopes = profiler::ThreadBuffer::capacity / 2; // the buffer never fills up
+
+	auto measure_ns = [&](auto f) {
+		chrono::steady_clock::duration total{};
+		for (int b = 0; b < batches; ++b)
+		{
+			const auto start = chrono::steady_clock::now();
+			for (int i = 0; i < scopes; ++i)
+				f(i);
+			total += chrono::steady_clock::now() - start;
+			profiler.Flush();
+		}
+		return chrono::duration<double, nano>(total).count() / (static_cast<double>(batches) * scopes);
+	};
+
+	volatile int sink = 0;
+	volatile std::uint64_t ticks = 0;
+	const auto emptyNs = measure_ns([&](int i) { sink = i; });
+	const auto clockNs = measure_ns([&](int i) { const auto start = profiler::Ticks(); sink = i; ticks = profiler::Ticks() - start; });
+	const auto profiledNs = measure_ns([&](int i) { auto scope = profiler::ProfileScope("benchmark_scope_profiler"); sink = i; });
+	cout << "per scope: " << profiledNs - emptyNs << " ns, of which reading the clock twice " << clockNs - emptyNs
+		<< " ns (loop alone " << emptyNs << " ns)\n";
+}
+
 // Another useful example: using external APIs quickly
 
 // imagine that this bunch of function is completely our of your control
@@ -43,6 +114,89 @@ void UseApi()
 	*/
 }
 
+// when UseApi runs often, Initialize and Finalize dominate: a TokenPool (see token_pool.h)
+// recycles the tokens and finalizes the extra ones in the background
+void UsePooledApi(TokenPool& pool)
+{
+	auto token = pool.Acquire();
+	Use(token.get());
+}
+
+template<typename F>
+long long measure_ms(F f)
+{
+	const auto start = chrono::steady_clock::now();
+	f();
+	return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+}
+
+// stubs of an API with expensive setup and teardown
+void Spin(chrono::microseconds duration)
+{
+	const auto until = chrono::steady_clock::now() + duration;
+	while (chrono::steady_clock::now() < until)
+		;
+}
+
+void* CostlyInitialize() { Spin(chrono::microseconds(5)); return new int{}; }
+void CostlyFinalize(void* token) { Spin(chrono::microseconds(5)); delete static_cast<int*>(token); }
+
+void benchmark_token_pool()
+{
+	const int calls = 100000;
+	const auto finallyMs = measure_ms([&] {
+		for (int i = 0; i < calls; ++i)
+		{
+			auto token = CostlyInitialize();
+			auto finalizer = gsl::finally([=] { CostlyFinalize(token); });
+			Use(token);
+		}
+	});
+	const auto pooledMs = measure_ms([&] {
+		TokenPool pool(CostlyInitialize, CostlyFinalize);
+		for (int i = 0; i < calls; ++i)
+			UsePooledApi(pool);
+	}); // includes finalizing the pool
+	cout << "Initialize/Finalize each time " << finallyMs << " ms, TokenPool " << pooledMs << " ms\n";
+}
+
+// scope_exit/scope_success/scope_fail (see GSL-edited-files/gsl_util.h): transactional code
+// undoes its steps only when something throws
+void Transfer(vector<int>& from, vector<int>& to, bool fail)
+{
+	to.push_back(from.back());
+	auto undo = gsl::make_scope_fail([&] { to.pop_back(); });
+	if (fail)
+		throw runtime_error("transfer failed");
+	from.pop_back();
+}
+
+// or keeps a rollback until the commit
+void Append(vector<int>& values, int value, bool commit)
+{
+	const auto size = values.size();
+	auto rollback = gsl::make_scope_exit([&] { values.resize(size); });
+	values.push_back(value);
+	if (commit)
+		rollback.dismiss();
+}
+
+void call_scope_guards()
+{
+	vector<int> from{ 1, 2, 3 }, to;
+	Transfer(from, to, false);
+	try
+	{
+		Transfer(from, to, true);
+	}
+	catch (const runtime_error&)
+	{
+	}
+	Append(to, 10, false);
+	Append(to, 20, true);
+	auto done = gsl::make_scope_success([&] { cout << "from: " << from.size() << " to: " << to.size() << "\n"; });
+}
+
 // An example of the Lifetime Checker in action:
 void Invalidate()
 {
@@ -53,7 +207,44 @@ void Invalidate()
 	cout << *first;
 }
 
-int main()
+volatile int scopeSink = 0;
+
+// the same epilogue written by hand and with each guard
+#if defined(_MSC_VER)
+#define NOINLINE __declspec(noinline)
+#else
+#define NOINLINE __attribute__((noinline))
+#endif
+
+NOINLINE void ByHand(int i) { scopeSink = i; scopeSink = 0; }
+NOINLINE void WithFinally(int i) { auto guard = gsl::finally([] { scopeSink = 0; }); scopeSink = i; }
+NOINLINE void WithScopeExit(int i) { auto guard = gsl::make_scope_exit([] { scopeSink = 0; }); scopeSink = i; }
+NOINLINE void WithScopeFail(int i) { auto guard = gsl::make_scope_fail([] { scopeSink = 0; }); scopeSink = i; }
+
+void benchmark_scope_guards()
+{
+	const int calls = 100000000;
+	const auto handMs = measure_ms([] { for (int i = 0; i < calls; ++i) ByHand(i); });
+	const auto finallyMs = measure_ms([] { for (int i = 0; i < calls; ++i) WithFinally(i); });
+	const auto exitMs = measure_ms([] { for (int i = 0; i < calls; ++i) WithScopeExit(i); });
+	const auto failMs = measure_ms([] { for (int i = 0; i < calls; ++i) WithScopeFail(i); });
+	cout << "by hand " << handMs << " ms, finally " << finallyMs << " ms, scope_exit " << exitMs
+		<< " ms, scope_fail " << failMs << " ms\n";
+}
+
+int main(int argc, char* argv[])
 {
 	LogThisFunctionExit();
+	cout << "\n";
+	const auto bench = argc > 1 && argv[1] == "bench"s;
+	call_scope_profiler(bench ? "lifetime_trace.json" : nullptr);
+	call_scope_guards();
+
+	// run with "bench" to measure (and to write the trace)
+	if (bench)
+	{
+		benchmark_scope_profiler();
+		benchmark_token_pool();
+		benchmark_scope_guards();
+	}
 }
\ No newline at end of file
@@ -0,0 +1,163 @@
+#pragma once
+#include "gsl.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Pool of tokens of the Initialize/Use/Finalize pattern
+//
+// Acquire hands out an idle token (Initialize is called only when there is none) and the
+// Token gives it back when destroyed: in a steady state neither Initialize nor Finalize
+// runs on the calling thread. Tokens above maxIdle, and the ones Discarded, are finalized
+// in batches by a background thread. The destructor finalizes every token left, thus
+// finalization is guaranteed (tokens must be returned before).
+// Only for APIs whose tokens can be used again after Use.
+class TokenPool
+{
+public:
+	using Initializer = std::function<void*()>;
+	using Finalizer = std::function<void(void*)>;
+
+	class Token
+	{
+	public:
+		Token(Token&& other) noexcept : pool(other.pool), token(other.token)
+		{
+			other.pool = nullptr;
+		}
+
+		Token(const Token&) = delete;
+		Token& operator=(const Token&) = delete;
+		Token& operator=(Token&&) = delete;
+
+		~Token()
+		{
+			if (pool)
+				pool->Release(token);
+		}
+
+		void* get() const noexcept { return token; }
+
+		// the state is not reusable: it will be finalized instead of recycled
+		void Discard()
+		{
+			Expects(pool != nullptr);
+			pool->Retire(token);
+			pool = nullptr;
+		}
+
+	private:
+		friend class TokenPool;
+		Token(TokenPool& pool, void* token) : pool(&pool), token(token) {}
+
+		TokenPool* pool;
+		void* token;
+	};
+
+	TokenPool(Initializer initialize, Finalizer finalize, std::size_t maxIdle = 64, std::size_t batchSize = 16)
+		: initialize(std::move(initialize)), finalize(std::move(finalize)), maxIdle(maxIdle), batchSize(batchSize)
+	{
+		Expects(this->initialize && this->finalize && batchSize > 0);
+		idle.reserve(maxIdle);
+		reclaimer = std::thread([this] { Reclaim(); });
+	}
+
+	TokenPool(const TokenPool&) = delete;
+	TokenPool& operator=(const TokenPool&) = delete;
+
+	~TokenPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wakeUp.notify_one();
+		reclaimer.join();
+		// the reclaimer finalized the retired tokens before leaving
+		for (auto token : idle)
+			finalize(token);
+	}
+
+	Token Acquire()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!idle.empty())
+			{
+				auto token = idle.back();
+				idle.pop_back();
+				return{ *this, token };
+			}
+		}
+		return{ *this, initialize() };
+	}
+
+	std::size_t Idle()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return idle.size();
+	}
+
+private:
+	void Release(void* token)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (idle.size() < maxIdle)
+			{
+				idle.push_back(token);
+				return;
+			}
+		}
+		Retire(token);
+	}
+
+	void Retire(void* token)
+	{
+		bool wake;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			retired.push_back(token);
+			wake = retired.size() >= batchSize;
+		}
+		if (wake)
+			wakeUp.notify_one();
+	}
+
+	// finalizes outside the lock, a batch at a time
+	void Reclaim()
+	{
+		std::vector<void*> batch;
+		std::unique_lock<std::mutex> lock(mutex);
+		for (;;)
+		{
+			wakeUp.wait_for(lock, std::chrono::milliseconds(100), [this] { return stopping || retired.size() >= batchSize; });
+			batch.swap(retired);
+			const auto last = stopping;
+			lock.unlock();
+			for (auto token : batch)
+				finalize(token);
+			batch.clear();
+			lock.lock();
+			if (last && retired.empty())
+				return;
+		}
+	}
+
+	Initializer initialize;
+	Finalizer finalize;
+	std::size_t maxIdle;
+	std::size_t batchSize;
+
+	std::mutex mutex;
+	std::condition_variable wakeUp;
+	bool stopping = false;
+	std::vector<void*> idle;
+	std::vector<void*> retired;
+	std::thread reclaimer;
+};
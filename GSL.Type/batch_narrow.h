@@ -0,0 +1,183 @@
+#pragma once
+#include "gsl_util.h"
+#include "span.h"
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define BATCH_NARROW_SSE2
+#include <emmintrin.h>
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+#endif
+
+// Checked narrowing of whole arrays
+//
+// gsl::narrow<int>(x) converts one value and throws at the first loss: looping over millions
+// of values pays a check (and a possible throw) per element. gsl::narrow(in, out) converts
+// everything, never throws, and reports which elements lost information: the first index,
+// how many, and optionally a bitmap (bit i set if in[i] did not fit).
+// double/float -> int32 and int64 -> int32 use SSE2 (4 values at a time, loss detected by
+// converting back and comparing; double -> int32 uses AVX when enabled, e.g. /arch:AVX);
+// the other pairs fall back to the scalar checks of gsl::narrow.
+// As with narrow_cast, out[i] is unspecified when in[i] did not fit.
+
+namespace gsl
+{
+	struct narrow_result
+	{
+		std::ptrdiff_t first_failure = -1; // -1: every value fit
+		std::ptrdiff_t failures = 0;
+
+		explicit operator bool() const noexcept { return failures == 0; }
+	};
+
+	namespace details
+	{
+		// converts *width* values, returns a mask of the ones that did not fit
+		template<class T, class U>
+		struct narrow_kernel
+		{
+			static const int width = 1;
+
+			static unsigned convert(const U* in, T* out) noexcept
+			{
+				return narrow_into(*in, *out, narrow_category<T, U>{}) ? 0 : 1;
+			}
+		};
+
+#ifdef BATCH_NARROW_SSE2
+		// out of range values become INT_MIN, which does not convert back to the input
+		template<>
+		struct narrow_kernel<std::int32_t, double>
+		{
+			static const int width = 4;
+
+			static unsigned convert(const double* in, std::int32_t* out) noexcept
+			{
+#ifdef __AVX__
+				const auto values = _mm256_loadu_pd(in);
+				const auto ints = _mm256_cvttpd_epi32(values);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out), ints);
+				const auto fit = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_cvtepi32_pd(ints), values, _CMP_EQ_OQ));
+#else
+				const auto lo = _mm_loadu_pd(in);
+				const auto hi = _mm_loadu_pd(in + 2);
+				const auto loInts = _mm_cvttpd_epi32(lo);
+				const auto hiInts = _mm_cvttpd_epi32(hi);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi64(loInts, hiInts));
+				// NaN never compares equal
+				const auto fit = _mm_movemask_pd(_mm_cmpeq_pd(_mm_cvtepi32_pd(loInts), lo)) |
+					(_mm_movemask_pd(_mm_cmpeq_pd(_mm_cvtepi32_pd(hiInts), hi)) << 2);
+#endif
+				return ~static_cast<unsigned>(fit) & 0xF;
+			}
+		};
+
+		template<>
+		struct narrow_kernel<std::int32_t, float>
+		{
+			static const int width = 4;
+
+			static unsigned convert(const float* in, std::int32_t* out) noexcept
+			{
+				const auto values = _mm_loadu_ps(in);
+				const auto ints = _mm_cvttps_epi32(values);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out), ints);
+				const auto fit = _mm_movemask_ps(_mm_cmpeq_ps(_mm_cvtepi32_ps(ints), values));
+				return ~static_cast<unsigned>(fit) & 0xF;
+			}
+		};
+
+		// fits when the high half is the sign extension of the low half
+		// (SSE2 has no 64-bit compares: compare the 32-bit halves)
+		template<>
+		struct narrow_kernel<std::int32_t, std::int64_t>
+		{
+			static const int width = 4;
+
+			static unsigned convert(const std::int64_t* in, std::int32_t* out) noexcept
+			{
+				const auto a = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)));
+				const auto b = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2)));
+				const auto lows = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+				const auto highs = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out), lows);
+				const auto fit = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(highs, _mm_srai_epi32(lows, 31))));
+				return ~static_cast<unsigned>(fit) & 0xF;
+			}
+		};
+#endif
+
+		template<class T, class U>
+		narrow_result narrow_span(span<const U> in, span<T> out, std::uint64_t* bitmap) noexcept
+		{
+			using kernel = narrow_kernel<T, U>;
+			const auto src = in.data();
+			const auto dst = out.data();
+			const auto size = in.size();
+			narrow_result result;
+
+			auto record = [&](std::ptrdiff_t first, unsigned mask) {
+				for (auto i = first; mask; ++i, mask >>= 1)
+				{
+					if (!(mask & 1))
+						continue;
+					if (result.first_failure < 0)
+						result.first_failure = i;
+					++result.failures;
+					if (bitmap)
+						bitmap[i / 64] |= std::uint64_t{ 1 } << (i % 64);
+				}
+			};
+
+			// four groups per iteration, one branch for all of them
+			const auto w = kernel::width;
+			std::ptrdiff_t i = 0;
+			for (; i + 4 * w <= size; i += 4 * w)
+			{
+				const auto mask = kernel::convert(src + i, dst + i) |
+					(kernel::convert(src + i + w, dst + i + w) << w) |
+					(kernel::convert(src + i + 2 * w, dst + i + 2 * w) << (2 * w)) |
+					(kernel::convert(src + i + 3 * w, dst + i + 3 * w) << (3 * w));
+				if (mask)
+					record(i, mask);
+			}
+			for (; i + w <= size; i += w)
+			{
+				if (const auto mask = kernel::convert(src + i, dst + i))
+					record(i, mask);
+			}
+			// last values: through a zero-padded group
+			if (i < size)
+			{
+				U tailIn[kernel::width] = {};
+				T tailOut[kernel::width];
+				const auto tail = static_cast<std::size_t>(size - i);
+				std::memcpy(tailIn, src + i, tail * sizeof(U));
+				const auto mask = kernel::convert(tailIn, tailOut) & ((1u << tail) - 1);
+				std::memcpy(dst + i, tailOut, tail * sizeof(T));
+				if (mask)
+					record(i, mask);
+			}
+			return result;
+		}
+	}
+
+	template<class T, class U>
+	narrow_result narrow(span<const U> in, span<T> out)
+	{
+		Expects(in.size() == out.size());
+		return details::narrow_span(in, out, nullptr);
+	}
+
+	// failureBitmap needs a bit per value: (in.size() + 63) / 64 words
+	template<class T, class U>
+	narrow_result narrow(span<const U> in, span<T> out, span<std::uint64_t> failureBitmap)
+	{
+		Expects(in.size() == out.size() && failureBitmap.size() * 64 >= in.size());
+		std::memset(failureBitmap.data(), 0, failureBitmap.size() * sizeof(std::uint64_t));
+		return details::narrow_span(in, out, failureBitmap.data());
+	}
+}
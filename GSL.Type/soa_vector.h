@@ -0,0 +1,250 @@
+#pragma once
+#include "span.h"
+#include <cstdlib>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Structure of arrays
+//
+// vector<SimulationParams> stores coeff1, coeff2, coeff3 interleaved (array of structs):
+// a loop that only needs coeff1 and coeff2 drags coeff3 into the cache too,
+// and the compiler has to gather values with a stride to vectorize.
+// soa_vector<double, double, double> stores each member in its own aligned column instead,
+// exposing it as span<T>, while rows can still be visited one by one through proxies.
+// Like vector<bool>::reference, a row proxy refers to the columns: assigning a row (or a
+// value_type, i.e. a tuple) writes the values through, and swap(row, row) exchanges them.
+// Thus the iterators work with the mutating algorithms (copy, reverse, sort...); in
+// comparators use get<I>(x) (with using std::get), which works for both rows and tuples.
+
+// allocates on *Alignment* boundaries (e.g. a cache line, which also suits any SIMD register)
+template<typename T, std::size_t Alignment = 64>
+struct aligned_allocator
+{
+	using value_type = T;
+
+	template<typename U>
+	struct rebind { using other = aligned_allocator<U, Alignment>; };
+
+	aligned_allocator() = default;
+
+	template<typename U>
+	aligned_allocator(const aligned_allocator<U, Alignment>&) noexcept {}
+
+	T* allocate(std::size_t n)
+	{
+		// aligned_alloc requires the size to be a multiple of the alignment
+		const auto bytes = (n * sizeof(T) + Alignment - 1) / Alignment * Alignment;
+#ifdef _MSC_VER
+		auto ptr = _aligned_malloc(bytes, Alignment);
+#else
+		auto ptr = aligned_alloc(Alignment, bytes);
+#endif
+		if (!ptr)
+			throw std::bad_alloc();
+		return static_cast<T*>(ptr);
+	}
+
+	void deallocate(T* ptr, std::size_t) noexcept
+	{
+#ifdef _MSC_VER
+		_aligned_free(ptr);
+#else
+		free(ptr);
+#endif
+	}
+
+	template<typename U>
+	bool operator==(const aligned_allocator<U, Alignment>&) const noexcept { return true; }
+
+	template<typename U>
+	bool operator!=(const aligned_allocator<U, Alignment>&) const noexcept { return false; }
+};
+
+template<typename T>
+using aligned_vector = std::vector<T, aligned_allocator<T>>;
+
+template<typename... Ts>
+class soa_vector
+{
+	template<std::size_t I>
+	using column_type = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+	using indices = std::index_sequence_for<Ts...>;
+
+public:
+	using size_type = std::ptrdiff_t;
+	using value_type = std::tuple<Ts...>;
+
+	// proxy for the i-th row: get<I>() refers to the I-th column
+	template<typename Soa>
+	class basic_row
+	{
+	public:
+		basic_row(Soa& soa, size_type idx) : soa_(&soa), idx_(idx) {}
+		basic_row(const basic_row&) = default;
+
+		// assignments write the values, they do not rebind the proxy
+		basic_row& operator=(const basic_row& other)
+		{
+			assign(indices{}, other);
+			return *this;
+		}
+
+		template<typename OtherSoa>
+		basic_row& operator=(const basic_row<OtherSoa>& other)
+		{
+			assign(indices{}, other);
+			return *this;
+		}
+
+		basic_row& operator=(const value_type& values)
+		{
+			assign(indices{}, values);
+			return *this;
+		}
+
+		template<std::size_t I>
+		decltype(auto) get() const { return soa_->template column<I>()[idx_]; }
+
+		template<std::size_t I>
+		friend decltype(auto) get(const basic_row& r) { return r.template get<I>(); }
+
+		// a copy of the values
+		operator value_type() const { return values(indices{}); }
+
+		// rows are prvalues: swap takes them by value
+		friend void swap(basic_row l, basic_row r)
+		{
+			value_type tmp = l;
+			l = r;
+			r = tmp;
+		}
+
+		size_type index() const noexcept { return idx_; }
+
+	private:
+		template<std::size_t... Is>
+		value_type values(std::index_sequence<Is...>) const
+		{
+			return value_type{ get<Is>()... };
+		}
+
+		template<typename Row, std::size_t... Is>
+		void assign(std::index_sequence<Is...>, const Row& other)
+		{
+			using std::get;
+			(void)std::initializer_list<int>{ (this->template get<Is>() = get<Is>(other), 0)... };
+		}
+
+		Soa* soa_;
+		size_type idx_;
+	};
+
+	using row = basic_row<soa_vector>;
+	using const_row = basic_row<const soa_vector>;
+
+	template<typename Soa>
+	class basic_iterator : public std::iterator<std::random_access_iterator_tag, value_type, size_type, void, basic_row<Soa>>
+	{
+	public:
+		basic_iterator(Soa& soa, size_type idx) : soa_(&soa), idx_(idx) {}
+
+		basic_row<Soa> operator*() const { return{ *soa_, idx_ }; }
+		basic_iterator& operator++() { ++idx_; return *this; }
+		basic_iterator operator++(int) { auto ret = *this; ++idx_; return ret; }
+		basic_iterator& operator--() { --idx_; return *this; }
+		basic_iterator operator--(int) { auto ret = *this; --idx_; return ret; }
+		basic_iterator& operator+=(size_type n) { idx_ += n; return *this; }
+		basic_iterator& operator-=(size_type n) { idx_ -= n; return *this; }
+		basic_iterator operator+(size_type n) const { return{ *soa_, idx_ + n }; }
+		basic_iterator operator-(size_type n) const { return{ *soa_, idx_ - n }; }
+		size_type operator-(const basic_iterator& other) const { return idx_ - other.idx_; }
+		basic_row<Soa> operator[](size_type n) const { return{ *soa_, idx_ + n }; }
+		bool operator==(const basic_iterator& other) const { return idx_ == other.idx_; }
+		bool operator!=(const basic_iterator& other) const { return idx_ != other.idx_; }
+		bool operator<(const basic_iterator& other) const { return idx_ < other.idx_; }
+		bool operator>(const basic_iterator& other) const { return idx_ > other.idx_; }
+		bool operator<=(const basic_iterator& other) const { return idx_ <= other.idx_; }
+		bool operator>=(const basic_iterator& other) const { return idx_ >= other.idx_; }
+
+	private:
+		Soa* soa_;
+		size_type idx_;
+	};
+
+	using iterator = basic_iterator<soa_vector>;
+	using const_iterator = basic_iterator<const soa_vector>;
+
+	soa_vector() = default;
+
+	explicit soa_vector(size_type size) { resize(size); }
+
+	void push_back(const Ts&... values) { push_back_impl(indices{}, values...); }
+
+	void reserve(size_type capacity) { reserve_impl(indices{}, capacity); }
+
+	void resize(size_type size) { resize_impl(indices{}, size); }
+
+	void clear() { resize(0); }
+
+	size_type size() const noexcept { return gsl::narrow_cast<size_type>(std::get<0>(columns_).size()); }
+
+	bool empty() const noexcept { return size() == 0; }
+
+	// each column is contiguous and aligned: kernels can work column-wise
+	template<std::size_t I>
+	gsl::span<column_type<I>> column() noexcept
+	{
+		auto& col = std::get<I>(columns_);
+		return{ col.data(), gsl::narrow_cast<size_type>(col.size()) };
+	}
+
+	template<std::size_t I>
+	gsl::span<const column_type<I>> column() const noexcept
+	{
+		const auto& col = std::get<I>(columns_);
+		return{ col.data(), gsl::narrow_cast<size_type>(col.size()) };
+	}
+
+	row operator[](size_type idx)
+	{
+		Expects(idx >= 0 && idx < size());
+		return{ *this, idx };
+	}
+
+	const_row operator[](size_type idx) const
+	{
+		Expects(idx >= 0 && idx < size());
+		return{ *this, idx };
+	}
+
+	iterator begin() { return{ *this, 0 }; }
+	iterator end() { return{ *this, size() }; }
+	const_iterator begin() const { return{ *this, 0 }; }
+	const_iterator end() const { return{ *this, size() }; }
+
+private:
+	template<std::size_t... Is>
+	void push_back_impl(std::index_sequence<Is...>, const Ts&... values)
+	{
+		(void)std::initializer_list<int>{ (std::get<Is>(columns_).push_back(values), 0)... };
+	}
+
+	template<std::size_t... Is>
+	void reserve_impl(std::index_sequence<Is...>, size_type capacity)
+	{
+		(void)std::initializer_list<int>{ (std::get<Is>(columns_).reserve(capacity), 0)... };
+	}
+
+	template<std::size_t... Is>
+	void resize_impl(std::index_sequence<Is...>, size_type size)
+	{
+		(void)std::initializer_list<int>{ (std::get<Is>(columns_).resize(size), 0)... };
+	}
+
+	std::tuple<aligned_vector<Ts>...> columns_;
+};
@@ -1,7 +1,21 @@
 #include "gsl_util.h"
+#include "soa_vector.h"
+#include "batch_narrow.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <random>
+#include <typeinfo>
 #include <vector>
 
+// the batch Simulate engine uses SSE2 when available
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define SIMULATE_SSE2
+#include <emmintrin.h>
+#endif
+
 using namespace std;
 
 struct SimulationParams
@@ -33,6 +47,543 @@ double Simulate(const SimulationParams& params)
 	}
 }
 
+// Structure of arrays example
+
+// the same SimulationParams, but each coefficient lives in its own column
+enum SimulationColumn { Coeff1, Coeff2, Coeff3 };
+using SimulationParamsColumns = soa_vector<double, double, double>;
+
+SimulationParamsColumns ToColumns(gsl::span<const SimulationParams> params)
+{
+	SimulationParamsColumns columns;
+	columns.reserve(params.size());
+	for (const auto& p : params)
+		columns.push_back(p.coeff1, p.coeff2, p.coeff3);
+	return columns;
+}
+
+// rows are still there, when needed
+SimulationParams ToParams(SimulationParamsColumns::const_row row)
+{
+	return{ row.get<Coeff1>(), row.get<Coeff2>(), row.get<Coeff3>() };
+}
+
+// column-wise kernel: contiguous inputs and outputs, no branches, the compiler can use SIMD
+void AddCoefficients(gsl::span<const double> coeff1, gsl::span<const double> coeff2, gsl::span<double> out)
+{
+	Expects(coeff1.size() == out.size() && coeff2.size() == out.size());
+	const auto in1 = coeff1.data();
+	const auto in2 = coeff2.data();
+	const auto dst = out.data();
+	for (std::ptrdiff_t i = 0; i < out.size(); ++i)
+	{
+		[[gsl::suppress(bounds.1)]] // sizes checked above
+		{
+			dst[i] = in1[i] + in2[i];
+		}
+	}
+}
+
+void call_soa()
+{
+	vector<SimulationParams> params{ { 1.0, 2.0, 3.0 }, { 2.0, 3.0, 4.0 }, { 3.0, 4.0, 5.0 } };
+	auto columns = ToColumns(params);
+
+	vector<double> sums(params.size());
+	AddCoefficients(columns.column<Coeff1>(), columns.column<Coeff2>(), sums);
+	for (auto sum : sums)
+		cout << sum << " ";
+	cout << "\n";
+
+	for (auto row : columns)
+	{
+		row.get<Coeff3>() *= 10; // row proxies refer to the columns
+	}
+	const auto& constColumns = columns;
+	cout << "last row: " << ToParams(constColumns[2]).coeff3 << "\n";
+
+	// assigning rows writes the values: algorithms work on the iterators
+	SimulationParamsColumns copy(columns.size());
+	std::copy(constColumns.begin(), constColumns.end(), copy.begin());
+	std::reverse(copy.begin(), copy.end());
+	std::stable_sort(copy.begin(), copy.end(), [](const auto& l, const auto& r) {
+		using std::get;
+		return get<Coeff1>(l) < get<Coeff1>(r);
+	});
+	for (auto row : copy)
+		cout << "{ " << row.get<Coeff1>() << ", " << row.get<Coeff2>() << ", " << row.get<Coeff3>() << " } ";
+	cout << "\n";
+	std::sort(copy.begin(), copy.end(), [](const auto& l, const auto& r) {
+		using std::get;
+		return get<Coeff3>(l) > get<Coeff3>(r);
+	});
+	cout << "sorted by coeff3: " << copy[0].get<Coeff3>() << " " << copy[1].get<Coeff3>() << " " << copy[2].get<Coeff3>() << "\n";
+}
+
+// narrow() checks depend on the types (see GSL-edited-files/gsl_util.h): here a reference
+// that reasons on the values (sign, magnitude, bits) checks it over every pair of arithmetic types
+
+template<typename... Ts>
+struct TypeList {};
+
+using ArithmeticTypes = TypeList<bool, char, signed char, unsigned char, wchar_t, char16_t, char32_t,
+	short, unsigned short, int, unsigned, long, unsigned long, long long, unsigned long long,
+	float, double, long double>;
+
+template<typename T>
+bool IsNegative(T value) { return value < T{}; }
+
+inline bool IsNegative(bool) { return false; }
+
+// does the integer u have a value of type T?
+template<typename T, typename U>
+bool ReferenceFits(U u, std::true_type /*U is integral*/)
+{
+	const auto negative = IsNegative(u);
+	auto magnitude = static_cast<uintmax_t>(u);
+	if (negative)
+		magnitude = uintmax_t{ 0 } - magnitude;
+	if (is_integral<T>::value)
+	{
+		const auto max = static_cast<uintmax_t>(numeric_limits<T>::max());
+		return negative ? is_signed<T>::value && magnitude <= max + 1 : magnitude <= max;
+	}
+	// floating point: the significant bits must fit in the mantissa
+	while (magnitude && !(magnitude & 1))
+		magnitude >>= 1;
+	int bits = 0;
+	for (; magnitude; magnitude >>= 1)
+		++bits;
+	return bits <= numeric_limits<T>::digits;
+}
+
+// does the floating point u have a value of type T?
+template<typename T, typename U>
+bool ReferenceFits(U u, std::false_type)
+{
+	if (isnan(u) || isinf(u))
+		return is_floating_point<T>::value;
+	const auto x = static_cast<long double>(u);
+	if (is_integral<T>::value)
+	{
+		const auto bound = ldexp(1.0L, numeric_limits<T>::digits); // max + 1 and -lowest
+		return trunc(x) == x && x < bound && (is_signed<T>::value ? x >= -bound : x >= 0);
+	}
+	return fabsl(x) <= static_cast<long double>(numeric_limits<T>::max()) && static_cast<long double>(static_cast<T>(u)) == x;
+}
+
+template<typename T, typename U>
+bool ReferenceFits(U u)
+{
+	return ReferenceFits<T>(u, is_integral<U>{});
+}
+
+template<typename U>
+void AddFloatingTestValues(vector<U>&, std::false_type)
+{
+}
+
+template<typename U>
+void AddFloatingTestValues(vector<U>& values, std::true_type)
+{
+	const long double reals[] = { -0.0L, 0.5L, -0.5L, 1.5L, -1.5L, 0.1L, 1e30L, -1e30L, 1e300L, -1e300L,
+		numeric_limits<float>::max(), numeric_limits<float>::denorm_min(), numeric_limits<double>::denorm_min() };
+	for (auto real : reals)
+		if (fabsl(real) <= static_cast<long double>(numeric_limits<U>::max()))
+			values.push_back(static_cast<U>(real));
+	for (auto special : { numeric_limits<U>::max(), numeric_limits<U>::lowest(), numeric_limits<U>::min(), numeric_limits<U>::denorm_min(),
+		numeric_limits<U>::infinity(), -numeric_limits<U>::infinity(), numeric_limits<U>::quiet_NaN() })
+		values.push_back(special);
+}
+
+// boundaries of the usual types, plus values that do not round trip
+template<typename U>
+vector<U> NarrowTestValues()
+{
+	const long long signedSeeds[] = { 0, 1, 2, -1, -2, 127, 128, -128, -129, 255, 256, 32767, 32768, -32768, -32769,
+		65535, 65536, 2147483647, 2147483648, -2147483647 - 1, -2147483649, 4294967295, 4294967296, 16777217,
+		9007199254740992, 9007199254740993, numeric_limits<long long>::max(), numeric_limits<long long>::min() };
+	const unsigned long long unsignedSeeds[] = { 9223372036854775808ull, numeric_limits<unsigned long long>::max() };
+	vector<U> values;
+	for (auto seed : signedSeeds)
+		if (ReferenceFits<U>(seed) || is_floating_point<U>::value)
+			values.push_back(static_cast<U>(seed));
+	for (auto seed : unsignedSeeds)
+		if (ReferenceFits<U>(seed) || is_floating_point<U>::value)
+			values.push_back(static_cast<U>(seed));
+	AddFloatingTestValues(values, is_floating_point<U>{});
+	return values;
+}
+
+struct NarrowMatrixResult
+{
+	int pairs = 0;
+	int checks = 0;
+	int mismatches = 0;
+};
+
+template<typename T, typename U>
+void CheckNarrow(NarrowMatrixResult& result)
+{
+	++result.pairs;
+	for (U u : NarrowTestValues<U>())
+	{
+		bool fits = true;
+		try
+		{
+			gsl::narrow<T>(u);
+		}
+		catch (const gsl::narrowing_error&)
+		{
+			fits = false;
+		}
+		++result.checks;
+		if (fits != ReferenceFits<T>(u))
+		{
+			if (result.mismatches++ < 10)
+				cout << "narrow<" << typeid(T).name() << ">(" << typeid(U).name() << " " << +u << "): " << (fits ? "fits" : "throws") << "\n";
+		}
+	}
+}
+
+template<typename T, typename... Us>
+void CheckNarrowTo(NarrowMatrixResult& result, TypeList<Us...>)
+{
+	(void)initializer_list<int>{ (CheckNarrow<T, Us>(result), 0)... };
+}
+
+template<typename... Ts>
+NarrowMatrixResult CheckNarrowMatrix(TypeList<Ts...> types)
+{
+	NarrowMatrixResult result;
+	(void)initializer_list<int>{ (CheckNarrowTo<Ts>(result, types), 0)... };
+	return result;
+}
+
+void call_narrow_matrix()
+{
+	const auto result = CheckNarrowMatrix(ArithmeticTypes{});
+	cout << "narrow: " << result.pairs << " type pairs, " << result.checks << " values, " << result.mismatches << " mismatches\n";
+}
+
+// the previous gsl::narrow, for comparison: always a round trip plus a sign check
+template<class T, class U>
+T RoundTripNarrow(U u)
+{
+	T t = gsl::narrow_cast<T>(u);
+	if (static_cast<U>(t) != u)
+		throw gsl::narrowing_error();
+	if (!gsl::details::is_same_signedness<T, U>::value && ((t < T{}) != (u < U{})))
+		throw gsl::narrowing_error();
+	return t;
+}
+
+template<typename F>
+long long measure_ms(F f)
+{
+	const auto start = chrono::steady_clock::now();
+	f();
+	return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+}
+
+template<typename T, typename U>
+void benchmark_narrow_pair(const char* name, const vector<U>& values)
+{
+	const int times = 10000;
+	vector<T> out(values.size());
+	const auto roundTripMs = measure_ms([&] {
+		for (int t = 0; t < times; ++t)
+			for (size_t i = 0; i < values.size(); ++i)
+				out[i] = RoundTripNarrow<T>(values[i]);
+	});
+	const auto narrowMs = measure_ms([&] {
+		for (int t = 0; t < times; ++t)
+			for (size_t i = 0; i < values.size(); ++i)
+				out[i] = gsl::narrow<T>(values[i]);
+	});
+	const auto castMs = measure_ms([&] {
+		for (int t = 0; t < times; ++t)
+			for (size_t i = 0; i < values.size(); ++i)
+				out[i] = gsl::narrow_cast<T>(values[i]);
+	});
+	cout << name << ": round trip " << roundTripMs << " ms, narrow " << narrowMs << " ms, narrow_cast " << castMs
+		<< " ms (" << +out.back() << ")\n";
+}
+
+void benchmark_narrow()
+{
+	const int size = 16384;
+	vector<int16_t> shorts(size);
+	vector<int64_t> longs(size);
+	vector<unsigned> unsigneds(size);
+	vector<double> doubles(size);
+	for (int i = 0; i < size; ++i)
+	{
+		shorts[i] = static_cast<int16_t>(i - size / 2);
+		longs[i] = i - size / 2;
+		unsigneds[i] = static_cast<unsigned>(i);
+		doubles[i] = static_cast<double>(i - size / 2);
+	}
+	benchmark_narrow_pair<int32_t>("int16 -> int32", shorts);
+	benchmark_narrow_pair<int32_t>("int64 -> int32", longs);
+	benchmark_narrow_pair<int32_t>("uint32 -> int32", unsigneds);
+	benchmark_narrow_pair<int32_t>("double -> int32", doubles);
+}
+
+// Checked narrowing of whole arrays (see batch_narrow.h): no exceptions, a report instead
+
+void call_batch_narrow()
+{
+	const vector<double> coeffs{ 1.0, 2.0, 2.5, 4.0, -3.0, numeric_limits<double>::quiet_NaN(), 1e10 };
+	vector<int> cmds(coeffs.size());
+	uint64_t failed[1];
+	const auto result = gsl::narrow(gsl::span<const double>(coeffs), gsl::span<int>(cmds), failed);
+	cout << "failures: " << result.failures << ", first at " << result.first_failure << ", bitmap " << failed[0] << "\n";
+
+	const vector<int64_t> ids{ 1, -1, int64_t{ 1 } << 40, numeric_limits<int32_t>::min() };
+	vector<int32_t> ids32(ids.size());
+	cout << "ids fit: " << boolalpha << static_cast<bool>(gsl::narrow(gsl::span<const int64_t>(ids), gsl::span<int32_t>(ids32))) << "\n";
+}
+
+void benchmark_batch_narrow()
+{
+	// cache-sized batches, as when ingesting a stream: the conversion, not memory, is the cost
+	const int size = 16384;
+	const int times = 10000;
+	vector<double> coeffs(size);
+	vector<int64_t> ids(size);
+	for (int i = 0; i < size; ++i)
+	{
+		coeffs[i] = static_cast<double>(i % 1000 - 500);
+		ids[i] = i - size / 2;
+	}
+	vector<int> cmds(size);
+	vector<int32_t> ids32(size);
+
+	const auto loopMs = measure_ms([&] {
+		for (int t = 0; t < times; ++t)
+			for (int i = 0; i < size; ++i)
+				cmds[i] = gsl::narrow<int>(coeffs[i]);
+	});
+	const auto batchMs = measure_ms([&] {
+		for (int t = 0; t < times; ++t)
+			gsl::narrow(gsl::span<const double>(coeffs), gsl::span<int>(cmds));
+	});
+	const auto loop64Ms = measure_ms([&] {
+		for (int t = 0; t < times; ++t)
+			for (int i = 0; i < size; ++i)
+				ids32[i] = gsl::narrow<int32_t>(ids[i]);
+	});
+	const auto batch64Ms = measure_ms([&] {
+		for (int t = 0; t < times; ++t)
+			gsl::narrow(gsl::span<const int64_t>(ids), gsl::span<int32_t>(ids32));
+	});
+	cout << "double -> int: narrow loop " << loopMs << " ms, batch " << batchMs << " ms\n";
+	cout << "int64 -> int32: narrow loop " << loop64Ms << " ms, batch " << batch64Ms << " ms (" << cmds[size - 1] + ids32[size - 1] << ")\n";
+}
+
+// Batch Simulate: the same results as Simulate, for many params at once
+//
+// Simulate switches on cmd for each params: with mixed cmds the branch is unpredictable.
+// The batch engine works on blocks of rows and first looks at the cmds of the block:
+// blocks with a single cmd (e.g. sorted jobs) run the kernel of that branch over the
+// whole block (AddCoefficients, MultiplyCoefficients, or the NaN of the default branch
+// written in bulk); mixed blocks compute both branches and select the result with masks.
+// No branch per row, no index lists (gathers and scatters do not vectorize); with SSE2
+// two rows at a time.
+
+void MultiplyCoefficients(gsl::span<const double> coeff1, gsl::span<const double> coeff2, gsl::span<double> out)
+{
+	Expects(coeff1.size() == out.size() && coeff2.size() == out.size());
+	const auto in1 = coeff1.data();
+	const auto in2 = coeff2.data();
+	const auto dst = out.data();
+	for (std::ptrdiff_t i = 0; i < out.size(); ++i)
+	{
+		[[gsl::suppress(bounds.1)]] // sizes checked above
+		{
+			dst[i] = in1[i] * in2[i];
+		}
+	}
+}
+
+// the cmd of Simulate (static_cast<int>(coeff1)) when it is 1 or 2, otherwise 0: the default
+// branch (this is defined for NaN and huge values too, unlike the cast)
+// (bitwise operators: no branches, the loops over it can be vectorized)
+inline int CommandOf(double coeff1)
+{
+	const int inRange = (coeff1 >= 1.0) & (coeff1 < 3.0);
+	return inRange * (1 + (coeff1 >= 2.0));
+}
+
+const std::ptrdiff_t simulationBlock = 512; // rows, kept in L1
+
+// the cmds present in a block
+enum SimulationCommands { addCommand = 1, multiplyCommand = 2, defaultCommand = 4 };
+
+int CommandsOf(const double* coeff1, std::ptrdiff_t size)
+{
+	int commands = 0;
+	std::ptrdiff_t i = 0;
+	[[gsl::suppress(bounds.1)]] // i < size
+	{
+#ifdef SIMULATE_SSE2
+		const auto one = _mm_set1_pd(1.0), two = _mm_set1_pd(2.0), three = _mm_set1_pd(3.0);
+		auto adds = _mm_setzero_pd(), multiplies = _mm_setzero_pd(), inRange = _mm_castsi128_pd(_mm_set1_epi32(-1));
+		for (; i + 2 <= size; i += 2)
+		{
+			const auto x = _mm_loadu_pd(coeff1 + i);
+			const auto atLeast1 = _mm_cmpge_pd(x, one), atLeast2 = _mm_cmpge_pd(x, two), below3 = _mm_cmplt_pd(x, three);
+			adds = _mm_or_pd(adds, _mm_andnot_pd(atLeast2, atLeast1));
+			multiplies = _mm_or_pd(multiplies, _mm_and_pd(atLeast2, below3));
+			inRange = _mm_and_pd(inRange, _mm_and_pd(atLeast1, below3)); // NaN: false
+		}
+		commands = (_mm_movemask_pd(adds) ? addCommand : 0) | (_mm_movemask_pd(multiplies) ? multiplyCommand : 0) |
+			(_mm_movemask_pd(inRange) != 3 ? defaultCommand : 0);
+#endif
+		for (; i < size; ++i)
+			commands |= CommandOf(coeff1[i]) == 1 ? addCommand : CommandOf(coeff1[i]) == 2 ? multiplyCommand : defaultCommand;
+	}
+	return commands;
+}
+
+// all the branches at once, the cmd selects the result
+void SimulateMixed(const double* coeff1, const double* coeff2, double* out, std::ptrdiff_t size)
+{
+	std::ptrdiff_t i = 0;
+	[[gsl::suppress(bounds.1)]] // i < size
+	{
+#ifdef SIMULATE_SSE2
+		const auto one = _mm_set1_pd(1.0), two = _mm_set1_pd(2.0), three = _mm_set1_pd(3.0);
+		const auto nan = _mm_set1_pd(numeric_limits<double>::quiet_NaN());
+		for (; i + 2 <= size; i += 2)
+		{
+			const auto x = _mm_loadu_pd(coeff1 + i), y = _mm_loadu_pd(coeff2 + i);
+			const auto multiply = _mm_cmpge_pd(x, two);
+			const auto inRange = _mm_and_pd(_mm_cmpge_pd(x, one), _mm_cmplt_pd(x, three));
+			const auto result = _mm_or_pd(_mm_and_pd(multiply, _mm_mul_pd(x, y)), _mm_andnot_pd(multiply, _mm_add_pd(x, y)));
+			_mm_storeu_pd(out + i, _mm_or_pd(_mm_and_pd(inRange, result), _mm_andnot_pd(inRange, nan)));
+		}
+#endif
+		for (; i < size; ++i)
+		{
+			const auto cmd = CommandOf(coeff1[i]);
+			out[i] = cmd == 1 ? coeff1[i] + coeff2[i] : cmd == 2 ? coeff1[i] * coeff2[i] : numeric_limits<double>::quiet_NaN();
+		}
+	}
+}
+
+void SimulateBlock(const double* coeff1, const double* coeff2, double* out, std::ptrdiff_t size)
+{
+	switch (CommandsOf(coeff1, size))
+	{
+	case addCommand:
+		return AddCoefficients({ coeff1, size }, { coeff2, size }, { out, size });
+	case multiplyCommand:
+		return MultiplyCoefficients({ coeff1, size }, { coeff2, size }, { out, size });
+	case defaultCommand:
+		return static_cast<void>(fill_n(out, size, numeric_limits<double>::quiet_NaN()));
+	default:
+		return SimulateMixed(coeff1, coeff2, out, size);
+	}
+}
+
+// out[i] == Simulate({ coeff1[i], coeff2[i], ... }) (coeff3 is not used)
+void SimulateBatch(gsl::span<const double> coeff1, gsl::span<const double> coeff2, gsl::span<double> out)
+{
+	Expects(coeff1.size() == out.size() && coeff2.size() == out.size());
+	for (std::ptrdiff_t first = 0; first < out.size(); first += simulationBlock)
+	{
+		const auto size = min(simulationBlock, out.size() - first);
+		SimulateBlock(coeff1.data() + first, coeff2.data() + first, out.data() + first, size);
+	}
+}
+
+void SimulateBatch(const SimulationParamsColumns& params, gsl::span<double> out)
+{
+	SimulateBatch(params.column<Coeff1>(), params.column<Coeff2>(), out);
+}
+
+// rows are copied into columns a block at a time
+void SimulateBatch(gsl::span<const SimulationParams> params, gsl::span<double> out)
+{
+	Expects(params.size() == out.size());
+	double coeff1[simulationBlock], coeff2[simulationBlock];
+	for (std::ptrdiff_t first = 0; first < out.size(); first += simulationBlock)
+	{
+		const auto size = min(simulationBlock, out.size() - first);
+		for (std::ptrdiff_t i = 0; i < size; ++i)
+		{
+			coeff1[i] = params[first + i].coeff1;
+			coeff2[i] = params[first + i].coeff2;
+		}
+		SimulateBlock(coeff1, coeff2, out.data() + first, size);
+	}
+}
+
+bool SameResult(double l, double r)
+{
+	return l == r || (l != l && r != r); // NaN == NaN here
+}
+
+vector<SimulationParams> RandomParams(size_t count, bool sorted)
+{
+	mt19937 generator(42);
+	uniform_real_distribution<double> coeff1(-1.0, 4.0), coeff2(-10.0, 10.0);
+	vector<SimulationParams> params(count);
+	for (auto& p : params)
+		p = { coeff1(generator), coeff2(generator), coeff2(generator) };
+	if (sorted)
+		sort(begin(params), end(params), [](const auto& l, const auto& r) { return CommandOf(l.coeff1) < CommandOf(r.coeff1); });
+	return params;
+}
+
+void call_simulate_batch()
+{
+	auto params = RandomParams(10000, false);
+	const SimulationParams edges[] = { { 1.0, 2.0, 0.0 }, { 2.0, 3.0, 0.0 }, { 3.0, 1.0, 0.0 }, { 0.999, 1.0, 0.0 },
+		{ 2.999, 1.0, 0.0 }, { -0.5, 1.0, 0.0 }, { numeric_limits<double>::quiet_NaN(), 1.0, 0.0 } };
+	params.insert(end(params), begin(edges), end(edges));
+
+	vector<double> rows(params.size()), columns(params.size());
+	SimulateBatch(params, rows);
+	SimulateBatch(ToColumns(params), columns);
+	size_t mismatches = 0;
+	for (size_t i = 0; i < params.size(); ++i)
+	{
+		const auto expected = Simulate(params[i]);
+		mismatches += !SameResult(rows[i], expected) + !SameResult(columns[i], expected);
+	}
+	cout << "batch Simulate: " << params.size() << " params, " << mismatches << " mismatches\n";
+}
+
+void benchmark_simulate_batch()
+{
+	const size_t count = 1000000;
+	const int times = 20;
+	for (auto sorted : { false, true })
+	{
+		const auto params = RandomParams(count, sorted);
+		const auto columns = ToColumns(params);
+		vector<double> out(count);
+		const auto scalarMs = measure_ms([&] {
+			for (int t = 0; t < times; ++t)
+				for (size_t i = 0; i < count; ++i)
+					out[i] = Simulate(params[i]);
+		});
+		const auto rowsMs = measure_ms([&] {
+			for (int t = 0; t < times; ++t)
+				SimulateBatch(params, out);
+		});
+		const auto columnsMs = measure_ms([&] {
+			for (int t = 0; t < times; ++t)
+				SimulateBatch(columns, out);
+		});
+		cout << (sorted ? "sorted" : "mixed") << " cmds: Simulate " << scalarMs << " ms, batch (rows) " << rowsMs
+			<< " ms, batch (columns) " << columnsMs << " ms\n";
+	}
+}
+
 struct LegacyClass
 {
 	LegacyClass() : i(10), j(20)
@@ -61,7 +612,7 @@ struct LegacyClass
 	  //   ^___ this is new
 };
 
-int main()
+int main(int argc, char* argv[])
 {	
 	LegacyClass lc;
 	auto lc2 = lc;
@@ -75,4 +626,17 @@ int main()
 	{
 		cout << "cmd is not integer\n";
 	}
+
+	call_soa();
+	call_batch_narrow();
+	call_narrow_matrix();
+	call_simulate_batch();
+
+	// run with "bench" to measure
+	if (argc > 1 && argv[1] == "bench"s)
+	{
+		benchmark_batch_narrow();
+		benchmark_narrow();
+		benchmark_simulate_batch();
+	}
 }